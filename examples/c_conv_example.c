@@ -79,9 +79,7 @@ int main (int argc, char **argv)
     }
 
   /* free pstats */
-  free(pstats->mic);
-  free(pstats->tic);
-  free(pstats);
+  mine_free_pstats(&pstats);
 
   printf("\n");
 
@@ -108,9 +106,7 @@ int main (int argc, char **argv)
     }
 
   /* free cstats */
-  free(cstats->mic);
-  free(cstats->tic);
-  free(cstats);
+  mine_free_cstats(&cstats);
 
   /* free data */
   free(X.data);
@@ -32,8 +32,13 @@
 #include <string.h>
 #include <math.h>
 #include <float.h>
+#include <stdint.h>
 #include "mine.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 char *libmine_version = LIBMINE_VERSION;
 
 #define MAX(a, b) (((a) > (b) ? (a) : (b)))
@@ -42,105 +47,370 @@ char *libmine_version = LIBMINE_VERSION;
 #define TRUE 1
 #define FALSE 0
 
+/* workspace buffers are aligned to cache lines */
+#define ARENA_ALIGN(size) ((((size) + 63) / 64) * 64)
+
+/* default value of mine_options.max_hp2q_memory (64 MB) */
+#define MAX_HP2Q_MEMORY ((size_t) 64 * 1024 * 1024)
+
+/* default value of mine_options.min_parallel_clumps */
+#define MIN_PARALLEL_CLUMPS 10000
+
+/*
+ * margin of the row bounds (see row_bound()), larger than the rounding
+ * errors of the scores
+ */
+#define BOUND_TOL 1e-9
 
-void quicksort(double *a, int *idx, int l, int u)
+
+/*
+ * The mine_workspace structure holds all the buffers needed to compute a
+ * score. They are laid out in a single arena by layout_workspace().
+ */
+struct mine_workspace
 {
-  int i, m, idx_temp;
-  double a_temp;
+  mine_plan *plan;
+  char *arena;
 
-  if (l >= u)
-    return;
+  /* the prepared variables (mine_compute_score_ws()) */
+  mine_prepared px, py;
+
+  /* argsort(), radix_offs is sized for radix_threads threads */
+  uint64_t *keys, *keys_tmp;
+  int *idx_tmp;
+  long *radix_offs;
+  int radix_threads;
+
+  /* compute_score_plan() */
+  int *Q_map_temp, *Q_map, *P_map, *Q_tilde;
+  double *dp;
+
+  /* the rows of the score of y vs. x, merged by compute_score_plan() */
+  double **M_yx;
+
+  /* the bounds and the order of the rows of compute_score_plan() */
+  double *row_bound;
+  int *row_order;
+
+  /* OptimizeXAxis(), I_data holds I_size doubles */
+  int *c, *cumhist;
+  double *cd, *inv_c, **I, *I_data, *HP2Q;
+  size_t I_size;
+
+  /* OptimizeXAxisE() */
+  double *sumlog;
+};
+
+
+/* Returns the number of threads to be used according to opt */
+int get_num_threads(mine_options *opt)
+{
+#ifdef _OPENMP
+  if (opt->num_threads > 0)
+    return opt->num_threads;
+  else
+    return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+
+/* argsort() uses an 8-bit least significant digit radix sort */
+#define RADIX_BITS 8
+#define RADIX_SIZE 256
+#define RADIX_PASSES 8
+
+/* below this size argsort() uses insertion sort */
+#define RADIX_MIN_N 64
+
+/* from this size the radix passes are spread among threads */
+#define RADIX_PARALLEL_N 131072
+
+
+/*
+ * Returns a key whose unsigned integer order is the order of x. Negative
+ * zero is mapped to zero.
+ */
+uint64_t double_key(double x)
+{
+  uint64_t u;
+
+  if (x == 0.0)
+    x = 0.0;
 
-  m = l;
-  for (i=l+1; i<=u; i++)
+  memcpy(&u, &x, sizeof(u));
+
+  if (u & 0x8000000000000000ULL)
+    return ~u;
+  else
+    return u | 0x8000000000000000ULL;
+}
+
+
+/* Stable insertion sort of (keys, idx) by keys */
+void insertion_sort(uint64_t *keys, int *idx, int n)
+{
+  int i, j, idx_temp;
+  uint64_t key_temp;
+
+  for (i=1; i<n; i++)
     {
-      if (a[i] < a[l])
+      key_temp = keys[i];
+      idx_temp = idx[i];
+      for (j=i; (j>0) && (keys[j-1] > key_temp); j--)
         {
-          ++m;
+          keys[j] = keys[j-1];
+          idx[j] = idx[j-1];
+        }
+      keys[j] = key_temp;
+      idx[j] = idx_temp;
+    }
+}
 
-          idx_temp = idx[m];
-          idx[m] = idx[i];
-          idx[i] = idx_temp;
 
-          a_temp = a[m];
-          a[m] = a[i];
-          a[i] = a_temp;
-        }
+/*
+ * Stable LSD radix sort of (keys, idx) by keys. keys_tmp and idx_tmp are
+ * preallocated vectors of size n. The passes where all the keys share the
+ * same digit are skipped. If num_threads > 1, n >= RADIX_PARALLEL_N and the
+ * caller is not already in a parallel region, the passes are spread among
+ * num_threads threads, using offs, a preallocated vector of size
+ * num_threads*RADIX_SIZE (it can be NULL if num_threads is 1). Returns the
+ * number of passes performed: if it is odd the sorted data is in
+ * (keys_tmp, idx_tmp).
+ */
+int radix_sort(uint64_t *keys, int *idx, uint64_t *keys_tmp, int *idx_tmp,
+               int n, long *offs, int num_threads)
+{
+  int i, d, b, npass, skip[RADIX_PASSES];
+  int count[RADIX_PASSES][RADIX_SIZE];
+  long offs_serial[RADIX_SIZE];
+  int nthreads = 1;
+
+  memset(count, 0, sizeof(count));
+
+  /* the histograms of all the digits in a single read */
+  for (i=0; i<n; i++)
+    for (d=0; d<RADIX_PASSES; d++)
+      count[d][(keys[i] >> (d*RADIX_BITS)) & (RADIX_SIZE-1)]++;
+
+  npass = 0;
+  for (d=0; d<RADIX_PASSES; d++)
+    {
+      skip[d] = (count[d][(keys[0] >> (d*RADIX_BITS)) & (RADIX_SIZE-1)] == n);
+      if (!skip[d])
+        ++npass;
     }
 
-  idx_temp = idx[l];
-  idx[l] = idx[m];
-  idx[m] = idx_temp;
+#ifdef _OPENMP
+  if ((num_threads > 1) && (n >= RADIX_PARALLEL_N) && !omp_in_parallel())
+    nthreads = num_threads;
+#endif
+
+  /*
+   * offs[t*RADIX_SIZE + b] is the position where the thread t writes its
+   * next element of bucket b. The buckets are filled in thread order, so
+   * the sort stays stable.
+   */
+  if (nthreads == 1)
+    offs = offs_serial;
+
+#ifdef _OPENMP
+  #pragma omp parallel num_threads(nthreads) private(i, d, b)
+#endif
+  {
+    int t = 0, nt = 1;
+    long lo, hi, sum, temp;
+    uint64_t *src_k = keys, *dst_k = keys_tmp, *swap_k;
+    int *src_i = idx, *dst_i = idx_tmp, *swap_i;
+
+#ifdef _OPENMP
+    t = omp_get_thread_num();
+    nt = omp_get_num_threads();
+#endif
+    lo = ((long) n * t) / nt;
+    hi = ((long) n * (t+1)) / nt;
+
+    for (d=0; d<RADIX_PASSES; d++)
+      {
+        if (skip[d])
+          continue;
+
+        for (b=0; b<RADIX_SIZE; b++)
+          offs[t*RADIX_SIZE + b] = 0;
+        for (i=lo; i<hi; i++)
+          {
+            b = (int) ((src_k[i] >> (d*RADIX_BITS)) & (RADIX_SIZE-1));
+            offs[t*RADIX_SIZE + b]++;
+          }
+
+#ifdef _OPENMP
+        #pragma omp barrier
+        #pragma omp single
+#endif
+        {
+          sum = 0;
+          for (b=0; b<RADIX_SIZE; b++)
+            for (i=0; i<nt; i++)
+              {
+                temp = offs[i*RADIX_SIZE + b];
+                offs[i*RADIX_SIZE + b] = sum;
+                sum += temp;
+              }
+        }
+
+        for (i=lo; i<hi; i++)
+          {
+            b = (int) ((src_k[i] >> (d*RADIX_BITS)) & (RADIX_SIZE-1));
+            dst_k[offs[t*RADIX_SIZE + b]] = src_k[i];
+            dst_i[offs[t*RADIX_SIZE + b]] = src_i[i];
+            offs[t*RADIX_SIZE + b]++;
+          }
+
+#ifdef _OPENMP
+        #pragma omp barrier
+#endif
 
-  a_temp = a[l];
-  a[l] = a[m];
-  a[m] = a_temp;
+        swap_k = src_k; src_k = dst_k; dst_k = swap_k;
+        swap_i = src_i; src_i = dst_i; dst_i = swap_i;
+      }
+  }
 
-  quicksort(a, idx, l, m-1);
-  quicksort(a, idx, m+1, u);
+  return npass;
 }
 
 
-int *argsort(double *a, int n)
+/*
+ * Computes the indices idx that would sort a in increasing order. Ties keep
+ * their original order.
+ *
+ * Parameters
+ *   a (IN) : the vector to sort
+ *   n (IN) : number of elements of a
+ *   idx (OUT) : the indices. idx must be a preallocated vector of size n
+ *   keys, keys_tmp, idx_tmp (IN) : preallocated vectors of size n
+ *                                  (workspace)
+ *   offs (IN) : preallocated vector of size num_threads*RADIX_SIZE, or NULL
+ *               if num_threads is 1 (workspace)
+ *   num_threads (IN) : number of threads of the radix sort
+ *
+ * Returns
+ *   0 on success, 1 if an error occurs
+ */
+int argsort(double *a, int n, int *idx, uint64_t *keys, uint64_t *keys_tmp,
+            int *idx_tmp, long *offs, int num_threads)
 {
-  double *a_cpy;
-  int i, *idx;
+  int i, npass;
 
-  a_cpy = (double *) malloc(n * sizeof(double));
-  if (a_cpy == NULL)
-    return NULL;
+  /* fill idx and keys */
+  for (i=0; i<n; i++)
+    {
+      idx[i] = i;
+      keys[i] = double_key(a[i]);
+    }
 
-  idx = (int *) malloc(n * sizeof(int));
-  if (idx == NULL)
+  if (n < RADIX_MIN_N)
     {
-      free(a_cpy);
-      return NULL;
+      insertion_sort(keys, idx, n);
+      return 0;
     }
 
-  /* fill a_cpy */
-  memcpy(a_cpy, a, n * sizeof(double));
+  npass = radix_sort(keys, idx, keys_tmp, idx_tmp, n, offs, num_threads);
 
-  /* fill idx */
-  for (i=0; i<n; i++)
-    idx[i] = i;
+  if (npass % 2)
+    memcpy(idx, idx_tmp, n * sizeof(int));
 
-  quicksort(a_cpy, idx, 0, n-1);
-  free(a_cpy);
+  return 0;
+}
+
+
+/*
+ * Returns the table xlogx[k] = k*log(k) for k = 0, ..., n (0*log(0) = 0).
+ * All the entropies are computed from integer counts k <= n as
+ *   H = -sum_i (k_i/N) log(k_i/N) = (N*log(N) - sum_i k_i*log(k_i)) / N
+ * where N = sum_i k_i, so the table removes log() from the inner loops.
+ * Returns NULL if an error occurs.
+ */
+double *compute_xlogx(int n)
+{
+  int k;
+  double *xlogx;
+
+  xlogx = (double *) malloc ((n+1) * sizeof(double));
+  if (xlogx == NULL)
+    return NULL;
+
+  xlogx[0] = 0.0;
+  for (k=1; k<=n; k++)
+    xlogx[k] = (double) k * log((double) k);
 
-  return idx;
+  return xlogx;
 }
 
 
+/*
+ * The cumulative histogram matrix cumhist is stored by column: the column j
+ * (the points in the P partitions 0, ..., j) is the vector of the q counts
+ * cumhist[j*q], ..., cumhist[j*q+q-1], one for each Q partition. The entropy
+ * kernels below read whole columns with unit stride, and the loops are
+ * marked for vectorization when the compiler supports OpenMP 4.0.
+ */
+
+
 /*
  * Returns the entropy induced by the points on the partition Q.
  * See section 3.2.1, page 10, SOM.
  *
  * Parameters
- *   cumhist : cumulative histogram matrix along P_map
- *   cumhist_log : log(cumhist)
+ *   cumhist : cumulative histogram matrix along P_map (by column)
  *   q : number of rows of cumhist (number of partitions in Q_map)
  *   p : number of cols of cumhist (number of partitions in P_map)
  *   n : total number of points
+ *   xlogx : k*log(k) table, see compute_xlogx()
  */
-double hq(int **cumhist, double **cumhist_log, int q, int p, int n)
+double hq(int *cumhist, int q, int p, int n, double *xlogx)
 {
   int i;
-  double total, total_log, prob, prob_log, H = 0.0;
+  int *cp = &cumhist[(p-1)*q];
+  double sum = 0.0;
+
+#if defined(_OPENMP) && (_OPENMP >= 201307)
+  #pragma omp simd reduction(+:sum)
+#endif
+  for (i=0; i<q; i++)
+    sum += xlogx[cp[i]];
 
-  total = (double) n;
-  total_log = log(total);
+  return (xlogx[n] - sum) / (double) n;
+}
+
+/*
+ * Returns the conditional entropy H(Q|P) of the partition Q given the
+ * whole partition P (the p clumps).
+ *
+ * Parameters
+ *   cumhist : cumulative histogram matrix along P_map (by column)
+ *   c : c_1, ..., c_p
+ *   q : number of rows of cumhist (number of partitions in Q_map)
+ *   p : number of cols of cumhist (number of partitions in P_map)
+ *   n : total number of points
+ *   xlogx : k*log(k) table, see compute_xlogx()
+ */
+double hqp(int *cumhist, int *c, int q, int p, int n, double *xlogx)
+{
+  int i, j;
+  double sum = xlogx[c[0]];
 
   for (i=0; i<q; i++)
+    sum -= xlogx[cumhist[i]];
+
+  for (j=1; j<p; j++)
     {
-      prob = (double) cumhist[i][p-1] / total;
-      if (prob != 0)
-        {
-          prob_log = cumhist_log[i][p-1] - total_log;
-          H -= prob * prob_log;
-       }
+      sum += xlogx[c[j] - c[j-1]];
+      for (i=0; i<q; i++)
+        sum -= xlogx[cumhist[j*q + i] - cumhist[(j-1)*q + i]];
     }
 
-  return H;
+  return sum / (double) n;
 }
 
 /*
@@ -149,37 +419,21 @@ double hq(int **cumhist, double **cumhist_log, int q, int p, int n)
  *
  * Parameters
  *   c : c_1, ..., c_p
- *   c_log : log(c)
  *   s : s in c_s
  *   t : t in c_t
+ *   xlogx : k*log(k) table, see compute_xlogx()
  */
-double hp3(int *c, double *c_log, int s, int t)
+double hp3(int *c, int s, int t, double *xlogx)
 {
-  int sum;
-  double total, total_log, prob, prob_log, H = 0.0;
+  int total;
 
   if (s == t)
     return 0.0;
 
-  total = (double) c[t-1];
-  total_log = log(total);
-
-  prob = (double) c[s-1] / total;
-  if (prob != 0)
-    {
-      prob_log = c_log[s-1] - total_log;
-      H -= prob * prob_log;
-    }
-
-  sum = c[t-1] - c[s-1];
-  prob = (double) sum / total;
-  if (sum != 0)
-    {
-      prob_log = log((double) sum) - total_log;
-      H -= prob * prob_log;
-    }
+  total = c[t-1];
 
-  return H;
+  return (xlogx[total] - xlogx[c[s-1]] - xlogx[total - c[s-1]])
+    / (double) total;
 }
 
 
@@ -188,42 +442,28 @@ double hp3(int *c, double *c_log, int s, int t)
  * <c_0, c_s, c_t>, Q. See line 5 of Algorithm 2 in SOM.
  *
  * Parameters
- *   cumhist : cumulative histogram matrix along P_map
- *   cumhist_log : log(cumhist)
+ *   cumhist : cumulative histogram matrix along P_map (by column)
  *   c : c_1, ..., c_p
  *   q : number of rows of cumhist (number of partitions in Q_map)
- *   p : number of cols of cumhist (number of partitions in P_map)
  *   s : s in c_s
  *   t : t in c_t
+ *   xlogx : k*log(k) table, see compute_xlogx()
  */
-double hp3q(int **cumhist, double **cumhist_log, int *c, int q, int p, int s, int t)
-
+double hp3q(int *cumhist, int *c, int q, int s, int t, double *xlogx)
 {
-  int i, sum;
-  double total, total_log, prob, prob_log, H = 0.0;
+  int i, total;
+  int *cs = &cumhist[(s-1)*q], *ct = &cumhist[(t-1)*q];
+  double sum = 0.0;
 
-  total = (double) c[t-1];
-  total_log = log(total);
+  total = c[t-1];
 
+#if defined(_OPENMP) && (_OPENMP >= 201307)
+  #pragma omp simd reduction(+:sum)
+#endif
   for (i=0; i<q; i++)
-    {
-      prob = (double) cumhist[i][s-1] / total;
-      if (prob != 0)
-        {
-          prob_log = cumhist_log[i][s-1] - total_log;
-          H -= prob * prob_log;
-        }
-
-      sum = cumhist[i][t-1] - cumhist[i][s-1];
-      prob = (double) sum / total;
-      if (prob != 0)
-        {
-          prob_log = log((double) sum) - total_log;
-          H -= prob * prob_log;
-        }
-    }
+    sum += xlogx[cs[i]] + xlogx[ct[i] - cs[i]];
 
-  return H;
+  return (xlogx[total] - sum) / (double) total;
 }
 
 /*
@@ -231,38 +471,32 @@ double hp3q(int **cumhist, double **cumhist_log, int *c, int q, int p, int s, in
  * and Q. See line 13 of Algorithm 2, SOM.
  *
  * Parameters
- *   cumhist : cumulative histogram matrix along P_map
+ *   cumhist : cumulative histogram matrix along P_map (by column)
  *   c : c_1, ..., c_p
  *   q : number of rows of cumhist (number of partitions
  *       in Q_map)
- *   p : number of cols of cumhist (number of partitions
- *       in P_map)
  *   s : s in c_s
  *   t : t in c_t
+ *   xlogx : k*log(k) table, see compute_xlogx()
  */
-double hp2q(int **cumhist, int *c, int q, int p, int s, int t)
+double hp2q(int *cumhist, int *c, int q, int s, int t, double *xlogx)
 {
-  int i, sum;
-  double total, total_log, prob, prob_log, H = 0.0 ;
+  int i, total;
+  int *cs = &cumhist[(s-1)*q], *ct = &cumhist[(t-1)*q];
+  double sum = 0.0;
 
   if (s == t)
     return 0.0;
 
-  total = (double) (c[t-1] - c[s-1]);
-  total_log = log(total);
+  total = c[t-1] - c[s-1];
 
+#if defined(_OPENMP) && (_OPENMP >= 201307)
+  #pragma omp simd reduction(+:sum)
+#endif
   for (i=0; i<q; i++)
-    {
-      sum = cumhist[i][t-1] - cumhist[i][s-1];
-      prob = (double) sum / total;
-      if (prob != 0)
-        {
-          prob_log = log((double) sum) - total_log;
-          H -= prob * prob_log;
-        }
-    }
+    sum += xlogx[ct[i] - cs[i]];
 
-  return H;
+  return (xlogx[total] - sum) / (double) total;
 }
 
 /*
@@ -333,25 +567,22 @@ int EquipartitionYAxis(double *dy, int n, int y, int *Q_map, int *q)
  *   n (IN) : number of elements of dx
  *   Q_map (IN) : the map Q computed by EquipartitionYAxis sorted in
  *                increasing order by dx-values
+ *   Q_tilde (IN) : preallocated vector of size n (workspace)
  *   P_map (OUT) : the map P. P_map must be a preallocated vector
  *                 of size n
  *   p (OUT) : number of partitions in P_map
  *
  * Returns
- *   0 on success, 1 if an error occurs
+ *   0
  */
-int GetClumpsPartition(double *dx, int n, int *Q_map, int *P_map, int *p)
+int GetClumpsPartition(double *dx, int n, int *Q_map, int *Q_tilde,
+                       int *P_map, int *p)
 {
   int i, j, flag, c, s;
-  int *Q_tilde;
 
   i = 0;
   c = -1;
 
-  Q_tilde = (int *) malloc (n * sizeof(int));
-  if (Q_tilde == NULL)
-    return 1;
-
   memcpy(Q_tilde, Q_map, n*sizeof(int));
 
   while (i < n)
@@ -390,7 +621,6 @@ int GetClumpsPartition(double *dx, int n, int *Q_map, int *P_map, int *p)
     }
 
   *p = i + 1;
-  free(Q_tilde);
 
   return 0;
 }
@@ -404,53 +634,40 @@ int GetClumpsPartition(double *dx, int n, int *Q_map, int *P_map, int *p)
  *   k_hat (IN) : maximum number of clumps
  *   Q_map (IN) : the map Q computed by EquipartitionYAxis sorted in
  *                increasing order by dx-values
+ *   Q_tilde (IN) : preallocated vector of size n (workspace)
+ *   dp (IN) : preallocated vector of size n (workspace)
  *   P_map (OUT) : the map P. P_map must be a preallocated vector
  *                 of size n
  *   p (OUT) : number of partitions in P_map
  *
  * Returns
- *   0 on success, 1 if an error occurs
+ *   0
  */
 int GetSuperclumpsPartition(double *dx, int n, int k_hat, int *Q_map,
-                            int *P_map, int *p)
+                            int *Q_tilde, double *dp, int *P_map, int *p)
 {
-  int i, ret;
-  double *dp;
+  int i;
 
   /* clumps */
-  ret = GetClumpsPartition(dx, n, Q_map, P_map, p);
-  if (ret)
-    return 1;
+  GetClumpsPartition(dx, n, Q_map, Q_tilde, P_map, p);
 
   /* superclumps */
   if (*p > k_hat)
     {
-      dp = (double *) malloc (n * sizeof(double));
-      if (dp == NULL)
-        return 1;
-
       for (i=0; i<n; i++)
         dp[i] = (double) P_map[i];
 
       EquipartitionYAxis(dp, n, k_hat, P_map, p);
-
-      free(dp);
     }
 
   return 0;
 }
 
 
-/* Returns (c_1, ..., c_k) */
-int *compute_c(int *P_map, int p, int n)
+/* Computes c = (c_1, ..., c_p). c must be a preallocated vector of size p */
+void compute_c(int *P_map, int p, int n, int *c)
 {
   int i;
-  int *c;
-
-
-  c = (int *) malloc (p * sizeof(int));
-  if (c == NULL)
-    return NULL;
 
   for (i=0; i<p; i++)
     c[i] = 0;
@@ -460,168 +677,188 @@ int *compute_c(int *P_map, int p, int n)
 
   for (i=1; i<p; i++)
     c[i] += c[i-1];
-
-  return c;
 }
 
 
-double *compute_c_log(int *c, int p)
+/*
+ * Computes the cumulative histogram matrix along P_map, stored by column
+ * (see hq()). cumhist must be a preallocated vector of size q*p.
+ */
+void compute_cumhist(int *Q_map, int q, int *P_map, int p, int n,
+                     int *cumhist)
 {
-  int i;
-  double *c_log;
+  int i, j;
 
-  c_log = (double *) malloc (p * sizeof(double));
-  if (c_log == NULL)
-    return NULL;
+  for (i=0; i<q*p; i++)
+    cumhist[i] = 0;
 
-  for (i=0; i<p; i++)
-    if (c[i] != 0)
-      c_log[i] = log((double) c[i]);
-    else
-      c_log[i] = 0;
+  for (i=0; i<n; i++)
+    cumhist[P_map[i]*q + Q_map[i]]++;
 
-  return c_log;
+  for (j=1; j<p; j++)
+    for (i=0; i<q; i++)
+      cumhist[j*q + i] += cumhist[(j-1)*q + i];
 }
 
 
-/* Returns the cumulative histogram matrix along P_map */
-int **compute_cumhist(int *Q_map, int q, int *P_map, int p, int n)
+/*
+ * Initializes the I matrix, stored by column: I[l][t] is the score of the
+ * optimal partition of the first t clumps into l columns, minus H(Q). Only
+ * L+1 consecutive columns l are kept at a time: I[l] is the column
+ * (l-2) % (L+1) of I_data, so that I[l] reuses the memory of I[l-L-1]. I
+ * must be a preallocated vector of x+1 pointers, I_data a preallocated
+ * vector of size (L+1)*(p+1).
+ */
+void init_I(int p, int x, int L, double **I, double *I_data)
 {
-  int i, j;
-  int **cumhist;
-
+  int l;
+  size_t t;
 
-  cumhist = (int **) malloc (q * sizeof(int *));
-  if (cumhist == NULL)
-    return NULL;
+  for (l=2; l<=x; l++)
+    I[l] = &I_data[(size_t) ((l-2) % (L+1)) * (p+1)];
 
-  for (i=0; i<q; i++)
-    {
-      cumhist[i] = (int *) malloc (p * sizeof(int));
-      if (cumhist[i] == NULL)
-        {
-          for (j=0; j<i; j++)
-            free(cumhist[j]);
+  for (t=0; t<(size_t) (L+1) * (p+1); t++)
+    I_data[t] = 0.0;
+}
 
-          free(cumhist);
-          return NULL;
-        }
 
-      for (j=0; j<p; j++)
-        cumhist[i][j] = 0;
-    }
+/*
+ * Only the entries HP2Q[s][t] with 2 <= s <= t <= p are used, so the HP2Q
+ * matrix is packed by column: HP2Q[s][t] is stored in
+ * HP2Q[HP2Q_COL(t) + s-2].
+ */
+#define HP2Q_COL(t) (((size_t) ((t)-2) * (size_t) ((t)-1)) / 2)
 
-  for (i=0; i<n; i++)
-    cumhist[Q_map[i]][P_map[i]]++;
 
-  for (i=0; i<q; i++)
-    for (j=1; j<p; j++)
-      cumhist[i][j] += cumhist[i][j-1];
+/*
+ * Computes the column t of the HP2Q matrix, i.e. Ht[s-2] = HP2Q[s][t] for
+ * s = 2, ..., t, using num_threads threads.
+ */
+void compute_HP2Q_col(int *cumhist, int *c, int q, int t, double *xlogx,
+                      double *Ht, int num_threads)
+{
+  int s;
 
-  return cumhist;
+#ifdef _OPENMP
+  #pragma omp parallel for num_threads(num_threads) if (num_threads > 1)
+#endif
+  for (s=2; s<=t; s++)
+    Ht[s-2] = hp2q(cumhist, c, q, s, t, xlogx);
 }
 
 
-double ** compute_cumhist_log(int **cumhist, int q, int p)
+/*
+ * Computes the packed HP2Q matrix, see HP2Q_COL, using num_threads threads.
+ * HP2Q must be a preallocated vector of size HP2Q_COL(p+1).
+ */
+void compute_HP2Q(int *cumhist, int *c, int q, int p, double *xlogx,
+                  double *HP2Q, int num_threads)
 {
-  int i, j;
-  double **cumhist_log;
-
-  cumhist_log = (double **) malloc (q * sizeof(double *));
-  if (cumhist_log == NULL)
-    return NULL;
-
-  for (i=0; i<q; i++)
-    {
-      cumhist_log[i] = (double *) malloc (p * sizeof(double));
-      if (cumhist_log[i] == NULL)
-        {
-          for (j=0; j<i; j++)
-            free(cumhist_log[j]);
-
-          free(cumhist_log);
-          return NULL;
-        }
-
-      for (j=0; j<p; j++)
-        if (cumhist[i][j] != 0)
-          cumhist_log[i][j] = log((double) cumhist[i][j]);
-        else
-          cumhist_log[i][j] = 0;
-    }
+  int t;
 
-    return cumhist_log;
+  /* the cost of the column t is proportional to t */
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic, 16) num_threads(num_threads) \
+    if (num_threads > 1)
+#endif
+  for (t=3; t<=p; t++)
+    compute_HP2Q_col(cumhist, c, q, t, xlogx, &HP2Q[HP2Q_COL(t)], 1);
 }
 
 
-/* Initializes the I matrix */
-double **init_I(int p, int x)
+/*
+ * Computes the column t of the HP2Q matrix into Ht (see compute_HP2Q_col())
+ * and returns I[2][t] (see OptimizeXAxis()), using num_threads threads. Both
+ * read the same sums R(s,t) = sum_i xlogx[ct_i - cs_i] over the q rows:
+ * hp2q() is (xlogx[c_t - c_s] - R(s,t)) / (c_t - c_s) and hp3q() is
+ * (xlogx[c_t] - sumlog[s-1] - R(s,t)) / c_t, where sumlog[s-1] is the sum
+ * of xlogx over the column s-1 of cumhist. Therefore each sum is computed
+ * once instead of twice. I[2][t] is equal to the one of OptimizeXAxis() up
+ * to rounding.
+ */
+double compute_I2_HP2Q_col(int *cumhist, int *c, int q, int t, double *xlogx,
+                           double *sumlog, double *Ht, int num_threads)
 {
-  int i, j;
-  double **I;
-
-
-  I = (double **) malloc ((p+1) * sizeof(double *));
-  if (I == NULL)
-    return NULL;
-
-  for (i=0; i<=p; i++)
+  int s;
+  double F_max = -DBL_MAX;
+
+#if defined(_OPENMP) && (_OPENMP >= 201107)
+  #pragma omp parallel for reduction(max:F_max) num_threads(num_threads) \
+    if (num_threads > 1)
+#endif
+  for (s=1; s<=t; s++)
     {
-      I[i] = (double *) malloc ((x+1) * sizeof(double));
-      if (I[i] == NULL)
-        {
-          for (j=0; j<i; j++)
-            free(I[j]);
-          free(I);
-          return NULL;
-        }
-
-      for (j=0; j<=x; j++)
-        I[i][j] = 0.0;
+      int i, total = c[t-1] - c[s-1];
+      int *cs = &cumhist[(s-1)*q], *ct = &cumhist[(t-1)*q];
+      double F, R = 0.0;
+
+#if defined(_OPENMP) && (_OPENMP >= 201307)
+      #pragma omp simd reduction(+:R)
+#endif
+      for (i=0; i<q; i++)
+        R += xlogx[ct[i] - cs[i]];
+
+      /* hp3() - hp3q() */
+      F = (sumlog[s-1] + R - xlogx[c[s-1]] - xlogx[total]) / (double) c[t-1];
+      F_max = MAX(F, F_max);
+
+      if (s >= 2)
+        Ht[s-2] = (s == t) ? 0.0 : (xlogx[total] - R) / (double) total;
     }
 
-  return I;
+  return F_max;
 }
 
 
-/* Computes the HP2Q matrix */
-double **compute_HP2Q(int **cumhist, int*c, int q, int p)
+/* Returns TRUE if the HP2Q matrix for p clumps is not stored */
+int stream_HP2Q(int p, size_t max_hp2q_memory)
 {
-  int i, j, s, t;
-  double **HP2Q;
+  return (HP2Q_COL(p+1) * sizeof(double)) > max_hp2q_memory;
+}
 
 
-  HP2Q = (double **) malloc ((p+1) * sizeof(double *));
-  if (HP2Q == NULL)
-    return NULL;
+/*
+ * Returns I[l][t] (see init_I()) given the column Il = I[l-1] and the column
+ * t of HP2Q (Ht[s-2] = HP2Q[s][t]). See Algorithm 2 in SOM, lines 11-15.
+ * cd[s-1] = c[s-1] as double and inv_ct = 1/c[t-1]: the factor 1/c[t-1] of F
+ * is applied once after the maximization over s, which reads Il, Ht and cd
+ * contiguously.
+ */
+double optimize_I(double *Il, double *Ht, double *cd, double inv_ct, int l,
+                  int t)
+{
+  int s;
+  double F, F_max = -DBL_MAX, ct = cd[t-1];
 
-  for (i=0; i<=p; i++)
+#if defined(_OPENMP) && (_OPENMP >= 201307)
+  #pragma omp simd reduction(max:F_max)
+#endif
+  for (s=l-1; s<=t; s++)
     {
-      HP2Q[i] = (double *) malloc ((p+1) * sizeof(double));
-      if (HP2Q[i] == NULL)
-        {
-          for (j=0; j<i; j++)
-            free(HP2Q[j]);
-          free(HP2Q);
-          return NULL;
-        }
+      F = (cd[s-1] * Il[s]) - ((ct - cd[s-1]) * Ht[s-2]);
+      F_max = (F > F_max) ? F : F_max;
     }
 
-  for (t=3; t<=p; t++)
-    for (s=2; s<=t; s++)
-      HP2Q[s][t] = hp2q(cumhist, c, q, p, s, t);
-
-  return HP2Q;
+  return F_max * inv_ct;
 }
 
 
 /*
  * Returns the normalized MI scores.
  *
+ * The scores need only I[l][p] and each column I[l] is computed from
+ * I[l-1] alone, so the columns of I are built in blocks of L columns (see
+ * init_I()), L as large as the workspace allows (ws->I_size).
+ *
+ * The packed HP2Q matrix takes p(p-1)/2 doubles. If it exceeds
+ * max_hp2q_memory bytes, each block of I is built column of HP2Q by column
+ * (t in the outer loop), so only one column of HP2Q is kept in memory and
+ * HP2Q is computed again for each block. I[l][t] needs I[l-1][s] for s <= t
+ * only, so this order computes exactly the same values. With q rows, a block
+ * costs (p^2/2)*(q+L) operations instead of (p^2/2)*L.
+ *
  * Parameters
- *   dx (IN) : x-data sorted in increasing order by dx-values
- *   dy (IN) : y-data sorted in increasing order by dx-values
- *   n (IN) : number of elements in dx and dy
+ *   n (IN) : number of points
  *   Q_map (IN) : the map Q computed by EquipartitionYAxis() sorted in
  *                increasing order by dx-values
  *   q (IN) : number of partitions in Q_map
@@ -629,20 +866,21 @@ double **compute_HP2Q(int **cumhist, int*c, int q, int p)
  *                in increasing order by Dx-values
  *   p (IN) : number of partitions in P_map
  *   x (IN) : maximum grid size on dx-values
+ *   ws (IN) : the workspace, sized by the plan for p and x
  *   score (OUT) : mutual information scores. score must be a
  *                 preallocated array of dimension x-1
  * Returns
- *   0 on success, 1 if an error occurs
+ *   0
  */
-int OptimizeXAxis(double *dx, double *dy, int n, int *Q_map, int q,
-      int *P_map, int p, int x, double *score)
+int OptimizeXAxis(int n, int *Q_map, int q, int *P_map, int p, int x,
+                  mine_workspace *ws, double *score)
 {
-  int i, s, t, l;
-  int *c;
-  int **cumhist;
-  double **I, **HP2Q;
-  double F, F_max, HQ, ct, cs;
-  double **cumhist_log, *c_log;
+  int i, t, l, l0, l1, L, xe, stream;
+  int *c = ws->c, *cumhist = ws->cumhist;
+  double **I = ws->I, *HP2Q = ws->HP2Q, *xlogx = ws->plan->xlogx;
+  double *cd = ws->cd, *inv_c = ws->inv_c;
+  double HQ;
+  int num_threads = 1;
 
   /* return score=0 if p=1 */
   if (p == 1)
@@ -653,627 +891,2513 @@ int OptimizeXAxis(double *dx, double *dy, int n, int *Q_map, int q,
     }
 
   /* compute c */
-  c = compute_c(P_map, p, n);
-  if (c == NULL)
-    goto error_c;
-
-  /* precompute log(c) (log(c)=0 when c=0) */
-  c_log = compute_c_log(c, p);
-  if (c_log == NULL)
-    goto error_c_log;
+  compute_c(P_map, p, n, c);
 
   /* compute the cumulative histogram matrix along P_map */
-  cumhist = compute_cumhist(Q_map, q, P_map, p, n);
-  if (cumhist == NULL)
-    goto error_cumhist;
-
-  /* precompute log(cumhist) (log(cumhist)=0 when cumhist=0) */
-  cumhist_log = compute_cumhist_log(cumhist, q, p);
-  if (cumhist == NULL)
-    goto error_cumhist_log;
-  
-  /* I matrix initialization */
-  I = init_I(p, x);
-  if (I == NULL)
-    goto error_I;
-
-  /* Precomputes the HP2Q matrix */
-  HP2Q = compute_HP2Q(cumhist, c, q, p);
-  if (HP2Q == NULL)
-    goto error_HP2Q;
+  compute_cumhist(Q_map, q, P_map, p, n, cumhist);
+
+  /* only the rows with many clumps are worth spreading among threads */
+#ifdef _OPENMP
+  if ((p >= ws->plan->opt.min_parallel_clumps) && !omp_in_parallel())
+    num_threads = get_num_threads(&ws->plan->opt);
+#endif
+
+  /* c as double and its reciprocals */
+  for (i=0; i<p; i++)
+    {
+      cd[i] = (double) c[i];
+      inv_c[i] = 1.0 / cd[i];
+    }
+
+  /* the columns above p are equal to the column p (line 19 in SOM) */
+  xe = MIN(x, p);
+
+  /* I matrix initialization, see layout_workspace() for the size of I */
+  L = (int) MIN(ws->I_size / (p+1) - 1, (size_t) MAX(xe-2, 1));
+  init_I(p, xe, L, I, ws->I_data);
+
+  /* Precomputes the HP2Q matrix, if not too large */
+  stream = stream_HP2Q(p, ws->plan->opt.max_hp2q_memory);
+  if (!stream)
+    compute_HP2Q(cumhist, c, q, p, xlogx, HP2Q, num_threads);
 
   /* compute H(Q) */
-  HQ = hq(cumhist, cumhist_log, q, p, n);
+  HQ = hq(cumhist, q, p, n, xlogx);
 
   /* Find the optimal partitions of size 2, Algorithm 2 in SOM, lines 3-8 */
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic, 16) num_threads(num_threads) \
+    if (num_threads > 1)
+#endif
   for (t=2; t<=p; t++)
     {
-      F_max = -DBL_MAX;
+      int s;
+      double F, F_max = -DBL_MAX;
+
       for (s=1; s<=t; s++)
         {
-          F = hp3(c, c_log, s, t) - hp3q(cumhist, cumhist_log, c, q, p, s, t);
-          if (F > F_max)
-            {
-              I[t][2] = HQ + F;
-              F_max = F;
-            }
+          F = hp3(c, s, t, xlogx) - hp3q(cumhist, c, q, s, t, xlogx);
+          F_max = MAX(F, F_max);
         }
+      I[2][t] = F_max;
     }
 
+  score[0] = (HQ + I[2][p]) / MIN(log(2), log(q));
+
   /*
    * Inductively build the rest of the table of optimal partitions,
-   * Algorithm 2 in SOM, lines 10-17
+   * Algorithm 2 in SOM, lines 10-17, in blocks of the columns l0, ..., l1.
+   * The entries I[l][t] of the same l depend only on I[l-1], so they are
+   * computed in parallel (wavefront).
    */
-  for (l=3; l<=x; l++)
+  for (l0=3; l0<=xe; l0+=L)
     {
-      for (t=l; t<=p; t++)
+      l1 = MIN(l0+L-1, xe);
+
+      if (stream)
+        for (t=l0; t<=p; t++)
+          {
+            compute_HP2Q_col(cumhist, c, q, t, xlogx, HP2Q, num_threads);
+            for (l=l0; l<=MIN(l1, t); l++)
+              I[l][t] = optimize_I(I[l-1], HP2Q, cd, inv_c[t-1], l, t);
+          }
+      else
         {
-          ct = (double) c[t-1];
-          F_max = -DBL_MAX;
-          for (s=l-1; s<=t; s++)
+#ifdef _OPENMP
+          #pragma omp parallel private(l) num_threads(num_threads) \
+            if (num_threads > 1)
+#endif
+          for (l=l0; l<=l1; l++)
             {
-              cs = (double) c[s-1];
-              F = ((cs/ct) * (I[s][l-1]-HQ)) - (((ct-cs)/ct) * HP2Q[s][t]);
-
-              if (F > F_max)
-                {
-                  I[t][l] = HQ + F;
-                  F_max = F;
-                }
+              int u;
+
+#ifdef _OPENMP
+              #pragma omp for schedule(dynamic, 16)
+#endif
+              for (u=l; u<=p; u++)
+                I[l][u] = optimize_I(I[l-1], &HP2Q[HP2Q_COL(u)], cd,
+                                     inv_c[u-1], l, u);
             }
         }
+
+      /* score */
+      for (l=l0; l<=l1; l++)
+        score[l-2] = (HQ + I[l][p]) / MIN(log(l), log(q));
     }
 
   /* Algorithm 2 in SOM, line 19 */
-  for (i=p+1; i<=x; i++)
-    I[p][i] = I[p][p];
+  for (l=xe+1; l<=x; l++)
+    score[l-2] = (HQ + I[xe][p]) / MIN(log(l), log(q));
 
-  /* score */
-  for (i=2; i<=x; i++)
-    score[i-2] = I[p][i] / MIN(log(i), log(q));
+  return 0;
+}
 
-  /* start frees */
-  for (i=0; i<=p; i++)
-    free(HP2Q[i]);
-  free(HP2Q);
 
-  for (i=0; i<=p; i++)
-    free(I[i]);
-  free(I);
+/*
+ * As OptimizeXAxis(), but computes only the score of the grids with 2
+ * columns into score[0], with O(p*q) operations: neither the HP2Q matrix
+ * nor the table of optimal partitions is needed. The other x-2 scores are
+ * set to 0.
+ */
+int OptimizeXAxis2(int n, int *Q_map, int q, int *P_map, int p, int x,
+                   mine_workspace *ws, double *score)
+{
+  int i, s;
+  int *c = ws->c, *cumhist = ws->cumhist;
+  double *xlogx = ws->plan->xlogx;
+  double F, F_max = -DBL_MAX, HQ;
 
-  for (i=0; i<q; i++)
-    free(cumhist_log[i]);
-  free(cumhist_log);
+  for (i=0; i<x-1; i++)
+    score[i] = 0.0;
 
-  for (i=0; i<q; i++)
-    free(cumhist[i]);
-  free(cumhist);
+  /* return score=0 if p=1 */
+  if (p == 1)
+    return 0;
 
-  free(c_log);
-  free (c);
-  /* end frees */
+  compute_c(P_map, p, n, c);
+  compute_cumhist(Q_map, q, P_map, p, n, cumhist);
 
-  return 0;
+  HQ = hq(cumhist, q, p, n, xlogx);
 
-  /* gotos */
-  error_HP2Q:
-    for (i=0; i<=p; i++)
-      free(I[i]);
-    free(I);
-  error_I:
-    for (i=0; i<q; i++)
-      free(cumhist_log[i]);
-    free(cumhist_log);
-  error_cumhist_log: 
-    for (i=0; i<q; i++)
-      free(cumhist[i]);
-    free(cumhist);
-  error_cumhist:
-    free(c_log);
-  error_c_log:
-    free(c);
-  error_c:
-    return 1;
+  /* I[2][p], see OptimizeXAxis() */
+  for (s=1; s<=p; s++)
+    {
+      F = hp3(c, s, p, xlogx) - hp3q(cumhist, c, q, s, p, xlogx);
+      F_max = MAX(F, F_max);
+    }
+
+  score[0] = (HQ + F_max) / MIN(log(2), log(q));
+
+  return 0;
 }
 
 
 /*
- * Returns an initialized mine_score structure. Returns NULL if an error
- * occurs.
+ * As OptimizeXAxis(), for the few columns (x <= i+2 for q = i+2 rows) of
+ * the equicharacteristic matrix (EST_MIC_E_CLUMP). The scores are the same
+ * up to rounding, but:
+ *   - the HP2Q matrix is never stored: I is built column of HP2Q by column
+ *     (t in the outer loop) in a single pass;
+ *   - I[2] and the columns of HP2Q are computed from the same sums (see
+ *     compute_I2_HP2Q_col());
+ *   - the last column I[x] is needed only for t = p;
+ *   - with x = 2, only I[2][p] is computed (see OptimizeXAxis2()).
+ * The cost is (p^2/2)*(q+x-3) operations instead of (p^2/2)*(2q+x-2), the
+ * memory O(p*x) instead of O(p^2). See OptimizeXAxis() for the parameters.
  */
-mine_score *init_score(mine_problem *prob, mine_parameter *param)
+int OptimizeXAxisE(int n, int *Q_map, int q, int *P_map, int p, int x,
+                   mine_workspace *ws, double *score)
 {
-  int i, j;
-  double B;
-  mine_score *score;
+  int i, t, l, xe;
+  int *c = ws->c, *cumhist = ws->cumhist;
+  double **I = ws->I, *Ht = ws->HP2Q, *sumlog = ws->sumlog;
+  double *xlogx = ws->plan->xlogx, *cd = ws->cd, *inv_c = ws->inv_c;
+  double HQ, Ix;
+  int num_threads = 1;
 
-  if ((param->alpha > 0.0) && (param->alpha <= 1.0))
-    B = MAX(pow(prob->n, param->alpha), 4);
-  else if (param->alpha >= 4)
-    B = MIN(param->alpha, prob->n);
-  else
-    goto error_score;
+  if ((x == 2) || (p == 1))
+    return OptimizeXAxis2(n, Q_map, q, P_map, p, x, ws, score);
 
-  score = (mine_score *) malloc (sizeof(mine_score));
-  if (score == NULL)
-    goto error_score;
+  compute_c(P_map, p, n, c);
+  compute_cumhist(Q_map, q, P_map, p, n, cumhist);
 
-  score->n = MAX((int) floor(B/2.0), 2) - 1;
-  score->m = (int *) malloc(score->n * sizeof(int));
-  if (score->m == NULL)
-    goto error_score_m;
+#ifdef _OPENMP
+  if ((p >= ws->plan->opt.min_parallel_clumps) && !omp_in_parallel())
+    num_threads = get_num_threads(&ws->plan->opt);
+#endif
 
-  for (i=0; i<score->n; i++)
-    score->m[i] = (int) floor((double) B / (double) (i+2)) - 1;
+  for (i=0; i<p; i++)
+    {
+      cd[i] = (double) c[i];
+      inv_c[i] = 1.0 / cd[i];
+    }
 
-  score->M = (double **) malloc (score->n * sizeof(double *));
-  if (score->M == NULL)
-    goto error_score_M;
+  for (t=1; t<=p; t++)
+    {
+      sumlog[t-1] = 0.0;
+      for (i=0; i<q; i++)
+        sumlog[t-1] += xlogx[cumhist[(t-1)*q + i]];
+    }
 
-  for (i=0; i<score->n; i++)
+  HQ = hq(cumhist, q, p, n, xlogx);
+
+  /* the columns I[2], ..., I[xe-1] are stored, see layout_workspace() */
+  xe = MIN(x, p);
+  init_I(p, MAX(xe-1, 2), MAX(xe-3, 1), I, ws->I_data);
+
+  for (t=2; t<=p; t++)
     {
-      score->M[i] = (double *) malloc ((score->m[i]) * sizeof(double));
-      if (score->M[i] == NULL)
-        {
-          for (j=0; j<i; j++)
-            free(score->M[j]);
-          goto error_score_M_i;
-        }
+      I[2][t] = compute_I2_HP2Q_col(cumhist, c, q, t, xlogx, sumlog, Ht,
+                                    num_threads);
+      for (l=3; l<=MIN(xe-1, t); l++)
+        I[l][t] = optimize_I(I[l-1], Ht, cd, inv_c[t-1], l, t);
     }
 
-  return score;
+  /* Ht is the column p of HP2Q */
+  if (xe > 2)
+    Ix = optimize_I(I[xe-1], Ht, cd, inv_c[p-1], xe, p);
+  else
+    Ix = I[2][p];
 
-  error_score_M_i:
-    free(score->M);
-  error_score_M:
-    free(score->m);
-  error_score_m:
-    free(score);
-  error_score:
-    return NULL;
+  for (l=2; l<=x; l++)
+    score[l-2] = (HQ + ((l < xe) ? I[l][p] : Ix)) / MIN(log(l), log(q));
+
+  return 0;
 }
 
 
-/* See mine.h */
-mine_score *mine_compute_score(mine_problem *prob, mine_parameter *param)
+/*
+ * Returns the B parameter (maximum grid size) for n points. Returns a value < 0
+ * if alpha is not feasible.
+ */
+double get_B(int n, mine_parameter *param)
 {
-  int i, j, k, p, q, ret;
-  double *xx, *yy, *xy, *yx, *M_temp;
-  int *ix, *iy;
-  int *Q_map_temp, *Q_map, *P_map;
-  mine_score *score;
-
-  score = init_score(prob, param);
-  if (score == NULL)
-    goto error_score;
-
-  xx = (double *) malloc (prob->n * sizeof(double));
-  if (xx == NULL)
-    goto error_xx;
+  if ((param->alpha > 0.0) && (param->alpha <= 1.0))
+    return MAX(pow(n, param->alpha), 4);
+  else if (param->alpha >= 4)
+    return MIN(param->alpha, n);
+  else
+    return -1.0;
+}
 
-  yy = (double *) malloc (prob->n * sizeof(double));
-  if (yy == NULL)
-    goto error_yy;
 
-  xy = (double *) malloc (prob->n * sizeof(double));
-  if (xy == NULL)
-    goto error_xy;
+/* Returns the number of rows of the score matrix given B */
+int get_score_n(double B)
+{
+  return MAX((int) floor(B/2.0), 2) - 1;
+}
 
-  yx = (double *) malloc (prob->n * sizeof(double));
-  if (yx == NULL)
-    goto error_yx;
 
-  Q_map_temp = (int *) malloc (prob->n * sizeof(int));
-  if (Q_map_temp == NULL)
-    goto error_Q_temp;
+/*
+ * Reserves size bytes at the top of an arena and returns a pointer to them.
+ * If arena is NULL only top is updated, so that the same code computes the
+ * size of the arena and lays out the buffers.
+ */
+void *arena_take(char *arena, size_t *top, size_t size)
+{
+  size_t offset = *top;
 
-  Q_map = (int *) malloc (prob->n * sizeof(int));
-  if (Q_map == NULL)
-    goto error_Q;
+  *top += ARENA_ALIGN(size);
 
-  P_map = (int *) malloc (prob->n * sizeof(int));
-  if (P_map == NULL)
-    goto error_P;
+  return (arena == NULL) ? NULL : (void *) (arena + offset);
+}
 
-  ix = argsort(prob->x, prob->n);
-  if (ix == NULL)
-    goto error_ix;
 
-  iy = argsort(prob->y, prob->n);
-  if (iy == NULL)
-    goto error_iy;
+/*
+ * Lays out a score with n rows and len entries in block (see arena_take())
+ * and returns the size of the block. The block contains the mine_score
+ * structure, m, M and the rows of the matrix, in this order. The rows are
+ * stored one after the other (ragged): if block is not NULL the pointers of
+ * the structure are set and, if link is TRUE, M[i] is set from m[0], ...,
+ * m[i-1] (n is left unchanged).
+ */
+size_t layout_score(char *block, int n, size_t len, int link)
+{
+  int i;
+  size_t top = 0, offset;
+  int *m;
+  double **M, *data;
+  mine_score *score;
 
-  M_temp = (double *)malloc ((score->m[0]) * sizeof(double));
-  if (M_temp == NULL)
-    goto error_M_temp;
+  score = (mine_score *) arena_take(block, &top, sizeof(mine_score));
+  m = (int *) arena_take(block, &top, n * sizeof(int));
+  M = (double **) arena_take(block, &top, n * sizeof(double *));
+  data = (double *) arena_take(block, &top, len * sizeof(double));
 
-  /* build xx, yy, xy, yx */
-  for (i=0; i<prob->n; i++)
+  if (block != NULL)
     {
-      xx[i] = prob->x[ix[i]];
-      yy[i] = prob->y[iy[i]];
-      xy[i] = prob->x[iy[i]];
-      yx[i] = prob->y[ix[i]];
+      score->m = m;
+      score->M = M;
+      if (link)
+        for (i=0, offset=0; i<n; i++)
+          {
+            M[i] = &data[offset];
+            offset += m[i];
+          }
     }
 
-  /* x vs. y */
-  for (i=0; i<score->n; i++)
-    {
-      k = MAX((int) (param->c * (score->m[i]+1)), 1);
-
-      ret = EquipartitionYAxis(yy, prob->n, i+2, Q_map, &q);
-      if (ret)
-        goto error_0;
-
-      /* sort Q by x */
-      for (j=0; j<prob->n; j++)
-        Q_map_temp[iy[j]] = Q_map[j];
-      for (j=0; j<prob->n; j++)
-        Q_map[j] = Q_map_temp[ix[j]];
-
-      ret = GetSuperclumpsPartition(xx, prob->n, k, Q_map, P_map, &p);
-      if (ret)
-        goto error_0;
-
-      if (param->est == EST_MIC_APPROX)
-        ret = OptimizeXAxis(xx, yx, prob->n, Q_map, q, P_map, p, score->m[i]+1,
-                            score->M[i]);
-      else /* EST_MIC_E */
-        ret = OptimizeXAxis(xx, yx, prob->n, Q_map, q, P_map, p,
-                            MIN(i+2, score->m[i]+1), score->M[i]);
-      if (ret)
-        goto error_0;
-    }
+  return top;
+}
 
-  /* y vs. x */
-  for (i=0; i<score->n; i++)
-    {
-      k = MAX((int) (param->c * (score->m[i]+1)), 1);
 
-      ret = EquipartitionYAxis(xx, prob->n, i+2, Q_map, &q);
-      if (ret)
-        goto error_0;
+/* Returns the number of entries of the rows of score, m[0] + ... + m[n-1] */
+size_t score_len(int n, int *m)
+{
+  int i;
+  size_t len = 0;
 
-      /* sort Q by y */
-      for (j=0; j<prob->n; j++)
-        Q_map_temp[ix[j]] = Q_map[j];
-      for (j=0; j<prob->n; j++)
-        Q_map[j] = Q_map_temp[iy[j]];
+  for (i=0; i<n; i++)
+    len += m[i];
 
-      ret = GetSuperclumpsPartition(yy, prob->n, k, Q_map, P_map, &p);
-      if (ret)
-        goto error_0;
+  return len;
+}
 
-      if (param->est == EST_MIC_APPROX)
-        ret = OptimizeXAxis(yy, xy, prob->n, Q_map, q, P_map, p, score->m[i]+1,
-                            M_temp);
-      else /* EST_MIC_E */
-        ret = OptimizeXAxis(yy, xy, prob->n, Q_map, q, P_map, p,
-                            MIN(i+2, score->m[i]+1), M_temp);
 
-      if (ret)
-        goto error_0;
+/*
+ * Returns an initialized mine_score structure for n points, allocated in a
+ * single block (see layout_score()). Returns NULL if an error occurs.
+ */
+mine_score *init_score(int n, mine_parameter *param)
+{
+  int i, score_n;
+  size_t len;
+  double B;
+  char *block;
+  mine_score *score;
 
-      if (param->est == EST_MIC_APPROX)
-        for (j=0; j<score->m[i]; j++)
-          score->M[j][i] = MAX(M_temp[j], score->M[j][i]);
-      else /* EST_MIC_E */
-        for (j=0; j<MIN(i+1, score->m[i]); j++)
-          score->M[j][i] = M_temp[j];
-    }
+  B = get_B(n, param);
+  if (B < 0.0)
+    return NULL;
 
-  free(M_temp);
-  free(iy);
-  free(ix);
-  free(P_map);
-  free(Q_map);
-  free(Q_map_temp);
-  free(yx);
-  free(xy);
-  free(yy);
-  free(xx);
+  score_n = get_score_n(B);
 
-  return score;
+  for (i=0, len=0; i<score_n; i++)
+    len += (int) floor((double) B / (double) (i+2)) - 1;
 
-  error_0:
-    free(M_temp);
-  error_M_temp:
-    free(iy);
-  error_iy:
-    free(ix);
-  error_ix:
-    free(P_map);
-  error_P:
-    free(Q_map);
-  error_Q:
-    free(Q_map_temp);
-  error_Q_temp:
-    free(yx);
-  error_yx:
-    free(xy);
-  error_xy:
-    free(yy);
-  error_yy:
-    free(xx);
-  error_xx:
-    for (i=0; i<score->n; i++)
-      free(score->M[i]);
-    free(score->M);
-    free(score->m);
-    free(score);
-  error_score:
+  block = (char *) malloc (layout_score(NULL, score_n, len, FALSE));
+  if (block == NULL)
     return NULL;
-}
 
+  score = (mine_score *) block;
+  score->n = score_n;
+  layout_score(block, score_n, len, FALSE);
 
-/* See mine.h */
-char *mine_check_parameter(mine_parameter *param)
-{
-  if (((param->alpha <= 0.0) || (param->alpha > 1.0)) && (param->alpha < 4.0))
-    return "alpha must be in (0.0, 1.0] or >= 4.0";
-
-  if (param->c <= 0.0)
-    return "c must be > 0.0";
+  for (i=0; i<score->n; i++)
+    score->m[i] = (int) floor((double) B / (double) (i+2)) - 1;
 
-  if ((param->est != EST_MIC_APPROX) && (param->est != EST_MIC_E))
-    return "unknown estimator";
+  /* the rows are linked once m is set */
+  layout_score(block, score_n, len, TRUE);
 
-  return NULL;
+  return score;
 }
 
 
 /* See mine.h */
-double mine_mic(mine_score *score)
+size_t mine_score_size(mine_score *score)
 {
-  int i, j;
-  double score_max = 0.0;
-
-  for (i=0; i<score->n; i++)
-    for (j=0; j<score->m[i]; j++)
-      if (score->M[i][j] > score_max)
-        score_max = score->M[i][j];
-
-  return score_max;
+  return layout_score(NULL, score->n, score_len(score->n, score->m), FALSE);
 }
 
 
 /* See mine.h */
-double mine_mas(mine_score *score)
+mine_score *mine_relocate_score(void *block)
 {
-  int i, j;
-  double score_curr;
-  double score_max = 0.0;
+  mine_score *score = (mine_score *) block;
+  int *m;
 
-  for (i=0; i<score->n; i++)
-    for (j=0; j<score->m[i]; j++)
-      {
-        score_curr = fabs(score->M[i][j] - score->M[j][i]);
-        if (score_curr > score_max)
-          score_max = score_curr;
-      }
+  /* m is at a fixed offset, see layout_score() */
+  m = (int *) ((char *) block + ARENA_ALIGN(sizeof(mine_score)));
+  layout_score((char *) block, score->n, score_len(score->n, m), TRUE);
 
-  return score_max;
+  return score;
 }
 
 
 /* See mine.h */
-double mine_mev(mine_score *score)
+mine_score *mine_copy_score(mine_score *score)
 {
-  int i, j;
-  double score_max = 0.0;
+  size_t size;
+  void *block;
 
-  for (i=0; i<score->n; i++)
-    for (j=0; j<score->m[i]; j++)
-      if (((j==0) || (i==0)) && score->M[i][j] > score_max)
-        score_max = score->M[i][j];
+  size = mine_score_size(score);
+  block = malloc (size);
+  if (block == NULL)
+    return NULL;
 
-  return score_max;
+  memcpy(block, (void *) score, size);
+
+  return mine_relocate_score(block);
 }
 
 
-/* See mine.h */
-double mine_mcn(mine_score *score, double eps)
+/*
+ * Lays out the arrays of a variable of n samples with nq equipartitions in
+ * arena (see arena_take()). The table of the equipartitions takes
+ * O(nq^2) = O(B^2) ints, so the sizes are computed in size_t.
+ */
+void layout_prepared(mine_prepared *prep, int n, int nq, char *arena,
+                     size_t *top)
 {
-  int i, j;
-  double log_xy;
-  double score_min = DBL_MAX;
-  double delta = 0.0001; /* avoids overestimation of mcn */
-  double mic = mine_mic(score);
-
-  for (i=0; i<score->n; i++)
-    for (j=0; j<score->m[i]; j++)
-      {
-        log_xy = log((i+2) * (j+2)) / log(2.0);
-        if (((score->M[i][j]+delta) >= ((1.0 - eps) * mic))
-             && (log_xy < score_min))
-          score_min = log_xy;
-      }
-
-  return score_min;
+  int i;
+  int *Q_data;
+
+  prep->n = n;
+  prep->nq = nq;
+  prep->sorted = (double *) arena_take(arena, top, n * sizeof(double));
+  prep->idx = (int *) arena_take(arena, top, n * sizeof(int));
+  prep->q = (int *) arena_take(arena, top, nq * sizeof(int));
+  prep->Q = (int **) arena_take(arena, top, nq * sizeof(int *));
+
+  /* the equipartition into i+2 rows has at most i+2 rows (i+3 bounds) */
+  Q_data = (int *) arena_take(arena, top,
+                              ((size_t) nq * (nq+5) / 2) * sizeof(int));
+
+  if (arena != NULL)
+    for (i=0; i<nq; i++)
+      prep->Q[i] = &Q_data[(size_t) i * (i+5) / 2];
 }
 
 
-/* See mine.h */
-double mine_mcn_general(mine_score *score)
+/*
+ * Sorts and equipartitions x, filling the arrays of prep (see
+ * layout_prepared()). keys, keys_tmp, idx_tmp and Q_map are preallocated
+ * vectors of size n (workspace). The sort uses num_threads threads and the
+ * workspace offs (see radix_sort()). Returns 0 on success, 1 if an error
+ * occurs.
+ */
+int prepare(double *x, mine_prepared *prep, uint64_t *keys,
+            uint64_t *keys_tmp, int *idx_tmp, int *Q_map, long *offs,
+            int num_threads)
 {
-  int i, j;
-  double log_xy;
-  double score_min = DBL_MAX;
-  double delta = 0.0001; /* avoids overestimation of mcn */
-  double mic = mine_mic(score);
+  int i, j, r, n = prep->n;
 
-  for (i=0; i<score->n; i++)
-    for (j=0; j<score->m[i]; j++)
-      {
-        log_xy = log((i+2) * (j+2)) / log(2.0);
-        if (((score->M[i][j]+delta) >= (mic * mic)) && (log_xy < score_min))
-          score_min = log_xy;
-      }
+  if (argsort(x, n, prep->idx, keys, keys_tmp, idx_tmp, offs, num_threads))
+    return 1;
 
-  return score_min;
+  for (i=0; i<n; i++)
+    prep->sorted[i] = x[prep->idx[i]];
+
+  /* store each equipartition as the positions where its rows start */
+  for (i=0; i<prep->nq; i++)
+    {
+      EquipartitionYAxis(prep->sorted, n, i+2, Q_map, &prep->q[i]);
+
+      r = 0;
+      prep->Q[i][0] = 0;
+      for (j=1; j<n; j++)
+        if (Q_map[j] != Q_map[j-1])
+          prep->Q[i][++r] = j;
+      prep->Q[i][prep->q[i]] = n;
+    }
+
+  return 0;
 }
 
+
 /* See mine.h */
-double mine_tic(mine_score *score, int norm)
+mine_prepared *mine_prepare(double *x, int n, mine_parameter *param)
 {
-  int i, j, k=0;
-  double tic = 0.0;
+  int nq, ret;
+  size_t top;
+  double B;
+  char *block;
+  uint64_t *keys;
+  mine_prepared dry, *prep;
 
-  for (i=0; i<score->n; i++)
-    for (j=0; j<score->m[i]; j++)
-      {
-        tic += score->M[i][j];
-        k++;
-      }
+  B = get_B(n, param);
+  if (B < 0.0)
+    goto error_prep;
 
-  if (norm)
-    tic /= k;
+  nq = get_score_n(B);
 
-  return tic;
+  /* the structure and its arrays are stored in a single block */
+  top = ARENA_ALIGN(sizeof(mine_prepared));
+  layout_prepared(&dry, n, nq, NULL, &top);
+
+  block = (char *) malloc (top);
+  if (block == NULL)
+    goto error_prep;
+
+  prep = (mine_prepared *) block;
+  top = ARENA_ALIGN(sizeof(mine_prepared));
+  layout_prepared(prep, n, nq, block, &top);
+
+  /* keys, keys_tmp, idx_tmp and Q_map */
+  keys = (uint64_t *) malloc (n * (2*sizeof(uint64_t) + 2*sizeof(int)));
+  if (keys == NULL)
+    goto error_keys;
+
+  ret = prepare(x, prep, keys, &keys[n], (int *) &keys[2*n],
+                ((int *) &keys[2*n]) + n, NULL, 1);
+  free(keys);
+  if (ret)
+    goto error_keys;
+
+  return prep;
+
+  error_keys:
+    free(block);
+  error_prep:
+    return NULL;
 }
 
+
 /* See mine.h */
-double mine_gmic(mine_score *score, double p)
+void mine_free_prepared(mine_prepared **prep)
 {
-  int i, j, k, Z, B;
-  mine_score *score_sub, *C_star;
-  double gmic;
+  free(*prep);
+  *prep = NULL;
+}
 
-  /* alloc score_sub */
-  score_sub = (mine_score *) malloc (sizeof(mine_score));
 
-  /* alloc C_star */
-  C_star = (mine_score *) malloc (sizeof(mine_score));
-  C_star->m = (int *) malloc(score->n * sizeof(int));
-  C_star->M = (double **) malloc (score->n * sizeof(double *));
-  for (i=0; i<score->n; i++)
-    C_star->M[i] = (double *) malloc ((score->m[i]) * sizeof(double));
+/*
+ * Returns the map Q of the equipartition of the variable py into i+2 rows,
+ * sorted in increasing order by the values of the variable px.
+ *
+ * Parameters
+ *   px (IN) : the prepared variable defining the order of Q_map
+ *   py (IN) : the prepared variable defining the partition
+ *   i (IN) : the equipartition into i+2 rows is used
+ *   Q_map_temp (IN) : preallocated vector of size n (workspace)
+ *   Q_map (OUT) : the map Q. Q_map must be a preallocated vector of size n
+ */
+void get_Q_map(mine_prepared *px, mine_prepared *py, int i, int *Q_map_temp,
+               int *Q_map)
+{
+  int j, r;
 
-  /* prepare score_sub */
-  score_sub->M = score->M;
+  /* Q by original index */
+  for (r=0; r<py->q[i]; r++)
+    for (j=py->Q[i][r]; j<py->Q[i][r+1]; j++)
+      Q_map_temp[py->idx[j]] = r;
 
-  /* prepare C_star */
-  C_star->n = score->n;
-  for (i=0; i<C_star->n; i++)
-    C_star->m[i] = score->m[i];
+  /* sort Q by px */
+  for (j=0; j<px->n; j++)
+    Q_map[j] = Q_map_temp[px->idx[j]];
+}
 
-  /* compute C_star */
-  for (i=0; i<score->n; i++)
-    for (j=0; j<score->m[i]; j++)
-      {
-        B = (i+2) * (j+2);
-        score_sub->n = MAX((int) floor(B/2.0), 2) - 1;
-        score_sub->m = (int *) malloc(score_sub->n * sizeof(int));
-        for (k=0; k<score_sub->n; k++)
-          score_sub->m[k] = (int) floor((double) B / (double) (k+2)) - 1;
-
-        C_star->M[i][j] = mine_mic(score_sub);
-        free(score_sub->m);
-      }
 
-  /* p=0 -> geometric mean */
-  if (p == 0.0)
-    {
-      Z = 0;
-      gmic = 1.0;
-      for (i=0; i<C_star->n; i++)
-        for (j=0; j<C_star->m[i]; j++)
-          {
-            gmic *= C_star->M[i][j];
-            Z++;
-          }
-      gmic = pow(gmic, (double) Z);
-    }
-  /* p!=0 -> generalized mean */
-  else
-    {
-      Z = 0;
-      gmic = 0.0;
-      for (i=0; i<C_star->n; i++)
-        for (j=0; j<C_star->m[i]; j++)
-          {
-            gmic += pow(C_star->M[i][j], p);
-            Z++;
-          }
-      gmic /= (double) Z;
-      gmic = pow(gmic, 1.0/p);
-    }
+/*
+ * Returns the maximum number of columns of the grids of the row i of the
+ * (equi)characteristic matrix.
+ */
+int row_cols(mine_plan *plan, int i)
+{
+  if (plan->param.est == EST_MIC_APPROX)
+    return plan->score_m[i]+1;
+  else /* EST_MIC_E, EST_MIC_E_CLUMP */
+    return MIN(i+2, plan->score_m[i]+1);
+}
 
-  free(score_sub);
-  if (C_star->n != 0)
-    {
-      free(C_star->m);
-      for (i=0; i<C_star->n; i++)
-         free(C_star->M[i]);
-      free(C_star->M);
-    }
-  free(C_star);
 
-  return gmic;
+/*
+ * Returns the maximum number of superclumps of the row i, c times the
+ * number of columns m[i]+1.
+ */
+int row_superclumps(mine_plan *plan, int i)
+{
+  return MAX((int) (plan->param.c * (plan->score_m[i]+1)), 1);
 }
 
-/* See mine.h */
-void mine_free_score(mine_score **score)
+
+/*
+ * Lays out the buffers of ws in arena (see arena_take()) and returns the size
+ * of the arena. Each buffer of OptimizeXAxis() is sized for the worst grid
+ * row: row i has at most q = i+2 rows, p = min(row_superclumps(), n) clumps
+ * and x = row_cols() columns. The table of optimal partitions keeps two
+ * columns if HP2Q is stored, otherwise as many columns as fit in
+ * max_hp2q_memory bytes (at least two). OptimizeXAxisE() (EST_MIC_E_CLUMP)
+ * keeps x-2 columns of I and one column of HP2Q.
+ */
+size_t layout_workspace(mine_workspace *ws, mine_plan *plan, char *arena)
 {
-  int i;
-  mine_score *score_ptr = *score;
+  int i, n = plan->n, p, x, p_max = 0, x_max = 0;
+  size_t top = 0, cumhist_size = 0, I_size = 0, HP2Q_size = 0, size;
+  double *M_yx_data;
+
+  layout_prepared(&ws->px, n, plan->score_n, arena, &top);
+  layout_prepared(&ws->py, n, plan->score_n, arena, &top);
+
+  ws->keys = (uint64_t *) arena_take(arena, &top, n * sizeof(uint64_t));
+  ws->keys_tmp = (uint64_t *) arena_take(arena, &top, n * sizeof(uint64_t));
+  ws->idx_tmp = (int *) arena_take(arena, &top, n * sizeof(int));
+  ws->radix_threads = get_num_threads(&plan->opt);
+  ws->radix_offs = (long *) arena_take(arena, &top, ws->radix_threads *
+                                       RADIX_SIZE * sizeof(long));
+
+  ws->Q_map_temp = (int *) arena_take(arena, &top, n * sizeof(int));
+  ws->Q_map = (int *) arena_take(arena, &top, n * sizeof(int));
+  ws->P_map = (int *) arena_take(arena, &top, n * sizeof(int));
+  ws->Q_tilde = (int *) arena_take(arena, &top, n * sizeof(int));
+  ws->dp = (double *) arena_take(arena, &top, n * sizeof(double));
+
+  ws->row_bound = (double *) arena_take(arena, &top,
+                                        2 * plan->score_n * sizeof(double));
+  ws->row_order = (int *) arena_take(arena, &top,
+                                     2 * plan->score_n * sizeof(int));
+
+  ws->M_yx = (double **) arena_take(arena, &top,
+                                    plan->score_n * sizeof(double *));
+  for (i=0, size=0; i<plan->score_n; i++)
+    size += plan->score_m[i];
+  M_yx_data = (double *) arena_take(arena, &top, size * sizeof(double));
+  if (arena != NULL)
+    for (i=0, size=0; i<plan->score_n; i++)
+      {
+        ws->M_yx[i] = &M_yx_data[size];
+        size += plan->score_m[i];
+      }
 
-  if (score_ptr != NULL)
+  for (i=0; i<plan->score_n; i++)
     {
-      if (score_ptr->n != 0)
+      p = MIN(row_superclumps(plan, i), n);
+      x = row_cols(plan, i);
+
+      p_max = MAX(p, p_max);
+      x_max = MAX(x, x_max);
+      cumhist_size = MAX((size_t) (i+2) * p, cumhist_size);
+
+      if (plan->param.est == EST_MIC_E_CLUMP)
         {
-          free(score_ptr->m);
-          for (i=0; i<score_ptr->n; i++)
-            free(score_ptr->M[i]);
-          free(score_ptr->M);
+          size = (size_t) MAX(MIN(x, p)-2, 2) * (p+1);
+          I_size = MAX(size, I_size);
+          HP2Q_size = MAX((size_t) p, HP2Q_size);
+          continue;
         }
 
-      free(score_ptr);
-      score_ptr = NULL;
+      size = 0;
+      if (stream_HP2Q(p, plan->opt.max_hp2q_memory))
+        size = MIN(plan->opt.max_hp2q_memory / sizeof(double),
+                   (size_t) MAX(MIN(x, p)-1, 0) * (p+1));
+      I_size = MAX(MAX(size, 2 * (size_t) (p+1)), I_size);
+
+      /* see stream_HP2Q(), p can be lower than its maximum */
+      size = MIN(HP2Q_COL(p+1), plan->opt.max_hp2q_memory / sizeof(double));
+      HP2Q_size = MAX(MAX(size, (size_t) p), HP2Q_size);
     }
+
+  ws->c = (int *) arena_take(arena, &top, p_max * sizeof(int));
+  ws->cumhist = (int *) arena_take(arena, &top, cumhist_size * sizeof(int));
+  ws->cd = (double *) arena_take(arena, &top, p_max * sizeof(double));
+  ws->inv_c = (double *) arena_take(arena, &top, p_max * sizeof(double));
+  ws->I = (double **) arena_take(arena, &top, (x_max+1) * sizeof(double *));
+  ws->I_data = (double *) arena_take(arena, &top, I_size * sizeof(double));
+  ws->I_size = I_size;
+  ws->HP2Q = (double *) arena_take(arena, &top, HP2Q_size * sizeof(double));
+  ws->sumlog = (double *) arena_take(arena, &top, p_max * sizeof(double));
+
+  return top;
 }
 
 
-mine_pstats *mine_compute_pstats(mine_matrix *X, mine_parameter *param)
+/* See mine.h */
+mine_plan *mine_create_plan(int n, mine_parameter *param, mine_options *opt)
 {
-  int i, j, k;
-  mine_problem prob;
-  mine_score *score;
-  mine_pstats *stats;
+  int i;
+  double B;
+  mine_plan *plan;
+  mine_workspace ws;
 
-  /* Allocate memory for stats */
-  stats = (mine_pstats *) malloc(sizeof(mine_pstats));
-  stats->n = (X->n * (X->n-1)) / 2;
-  stats->mic = (double *) malloc(stats->n * sizeof(double));
-  stats->tic = (double *) malloc(stats->n * sizeof(double));
+  B = get_B(n, param);
+  if (B < 0.0)
+    goto error_plan;
 
-  k = 0;
-  prob.n = X->m;
-  for (i=0; i<X->n-1; i++)
-    {
-      prob.x = &X->data[i*X->m];
-      for (j=i+1; j<X->n; j++)
-        {
-          prob.y = &X->data[j*X->m];
-          score = mine_compute_score(&prob, param);
-          stats->mic[k] = mine_mic(score);
-          stats->tic[k] = mine_tic(score, TRUE);
-          mine_free_score(&score);
-          k++;
-        }
-    }
+  plan = (mine_plan *) malloc (sizeof(mine_plan));
+  if (plan == NULL)
+    goto error_plan;
 
-  return stats;
-}
+  plan->n = n;
+  plan->param = *param;
+  if (opt == NULL)
+    mine_init_options(&plan->opt);
+  else
+    plan->opt = *opt;
 
+  plan->score_n = get_score_n(B);
+  plan->score_m = (int *) malloc (plan->score_n * sizeof(int));
+  if (plan->score_m == NULL)
+    goto error_score_m;
 
+  for (i=0; i<plan->score_n; i++)
+    plan->score_m[i] = (int) floor((double) B / (double) (i+2)) - 1;
+
+  plan->xlogx = compute_xlogx(n);
+  if (plan->xlogx == NULL)
+    goto error_xlogx;
+
+  plan->workspace_size = layout_workspace(&ws, plan, NULL);
+
+  return plan;
+
+  error_xlogx:
+    free(plan->score_m);
+  error_score_m:
+    free(plan);
+  error_plan:
+    return NULL;
+}
+
+
+/* See mine.h */
+void mine_free_plan(mine_plan **plan)
+{
+  mine_plan *plan_ptr = *plan;
+
+  if (plan_ptr != NULL)
+    {
+      free(plan_ptr->xlogx);
+      free(plan_ptr->score_m);
+      free(plan_ptr);
+      *plan = NULL;
+    }
+}
+
+
+/* See mine.h */
+mine_workspace *mine_create_workspace(mine_plan *plan)
+{
+  mine_workspace *ws;
+
+  ws = (mine_workspace *) malloc (sizeof(mine_workspace));
+  if (ws == NULL)
+    return NULL;
+
+  ws->arena = (char *) malloc (plan->workspace_size);
+  if (ws->arena == NULL)
+    {
+      free(ws);
+      return NULL;
+    }
+
+  ws->plan = plan;
+  layout_workspace(ws, plan, ws->arena);
+
+  return ws;
+}
+
+
+/* See mine.h */
+void mine_free_workspace(mine_workspace **ws)
+{
+  mine_workspace *ws_ptr = *ws;
+
+  if (ws_ptr != NULL)
+    {
+      free(ws_ptr->arena);
+      free(ws_ptr);
+      *ws = NULL;
+    }
+}
+
+
+/* See mine.h */
+mine_score *mine_alloc_score(mine_plan *plan)
+{
+  return init_score(plan->n, &plan->param);
+}
+
+
+/*
+ * Computes the map Q (i+2 rows along py) and the superclumps partition P of
+ * the row i of px vs. py into ws->Q_map and ws->P_map. q and p are the
+ * number of partitions of Q and P.
+ */
+void row_partitions(mine_prepared *px, mine_prepared *py, int i,
+                    mine_workspace *ws, int *q, int *p)
+{
+  int k;
+
+  k = row_superclumps(ws->plan, i);
+
+  get_Q_map(px, py, i, ws->Q_map_temp, ws->Q_map);
+  *q = py->q[i];
+
+  GetSuperclumpsPartition(px->sorted, ws->plan->n, k, ws->Q_map, ws->Q_tilde,
+                          ws->dp, ws->P_map, p);
+}
+
+
+/*
+ * Returns TRUE if only the MEV is requested (mine_options.stats is
+ * STAT_MEV). The MEV reads only the grids with 2 rows or 2 columns, so
+ * compute_score_row() computes the row 0 and the first score of the other
+ * rows.
+ */
+int mev_only(mine_plan *plan)
+{
+  return plan->opt.stats == STAT_MEV;
+}
+
+
+/*
+ * Computes the row i of the (equi)characteristic matrix of the prepared
+ * variables px vs. py, i.e. the scores of the grids with i+2 rows (along py)
+ * and 2, ..., x columns, into M_row (see OptimizeXAxis() and, with
+ * EST_MIC_E_CLUMP, OptimizeXAxisE()). If only the MEV is requested (see
+ * mev_only()), for i > 0 only the score with 2 columns is computed (see
+ * OptimizeXAxis2()).
+ */
+void compute_score_row(mine_prepared *px, mine_prepared *py, int i, int x,
+                       mine_workspace *ws, double *M_row)
+{
+  int p, q;
+
+  row_partitions(px, py, i, ws, &q, &p);
+
+  if (mev_only(ws->plan) && (i > 0))
+    OptimizeXAxis2(ws->plan->n, ws->Q_map, q, ws->P_map, p, x, ws, M_row);
+  else if (ws->plan->param.est == EST_MIC_E_CLUMP)
+    OptimizeXAxisE(ws->plan->n, ws->Q_map, q, ws->P_map, p, x, ws, M_row);
+  else
+    OptimizeXAxis(ws->plan->n, ws->Q_map, q, ws->P_map, p, x, ws, M_row);
+}
+
+
+/*
+ * Returns an upper bound of the scores of the row i of px vs. py. The
+ * mutual information of a grid is at most H(Q), at most log(x) for x
+ * columns and, since the columns are unions of superclumps, at most the
+ * mutual information I(P;Q) of the superclumps partition P. Computing
+ * I(P;Q) takes O(n + p*q) operations, while OptimizeXAxis() takes
+ * O(p^2 * (q+x)).
+ */
+double row_bound(mine_prepared *px, mine_prepared *py, int i,
+                 mine_workspace *ws)
+{
+  int l, p, q, x, n = ws->plan->n;
+  double *xlogx = ws->plan->xlogx;
+  double IPQ, bound = 0.0;
+
+  row_partitions(px, py, i, ws, &q, &p);
+
+  /* OptimizeXAxis() returns a row of zeros */
+  if (p == 1)
+    return 0.0;
+
+  /* the scores are not defined, the row is never skipped */
+  if (q < 2)
+    return DBL_MAX;
+
+  compute_c(ws->P_map, p, n, ws->c);
+  compute_cumhist(ws->Q_map, q, ws->P_map, p, n, ws->cumhist);
+
+  IPQ = hq(ws->cumhist, q, p, n, xlogx) -
+    hqp(ws->cumhist, ws->c, q, p, n, xlogx);
+
+  x = row_cols(ws->plan, i);
+  for (l=2; l<=x; l++)
+    bound = MAX(MIN(IPQ, log(l)) / MIN(log(l), log(q)), bound);
+
+  return bound;
+}
+
+
+/*
+ * Returns TRUE if only the MIC is requested (mine_options.stats is
+ * STAT_MIC). Then compute_score_plan() skips the rows which cannot exceed
+ * the MIC.
+ */
+int mic_only(mine_plan *plan)
+{
+  return plan->opt.stats == STAT_MIC;
+}
+
+
+/*
+ * Sorts the n rows in order by decreasing bound, the rows with the same
+ * bound by index.
+ */
+void sort_rows(double *bound, int *order, int n)
+{
+  int i, j, k;
+
+  for (i=0; i<n; i++)
+    {
+      k = i;
+      for (j=i; (j > 0) && (bound[order[j-1]] < bound[k]); j--)
+        order[j] = order[j-1];
+      order[j] = k;
+    }
+}
+
+
+/*
+ * Computes the row k/2 of x vs. y (k even, into score) or y vs. x (k odd,
+ * into M_yx), see compute_score_plan(). If bound is not NULL (see
+ * mic_only()) the row is skipped when it cannot change the result given
+ * *mic, the maximum score of the rows computed so far, otherwise *mic is
+ * updated. With a screening threshold tau > 0 (mine_options.screen_tau) a
+ * row is also skipped when *mic >= tau or when bound[k] < tau, and then it
+ * is set to bound[k] (an upper bound of its scores) instead of 0.
+ */
+void compute_row(mine_prepared *px, mine_prepared *py, int k,
+                 mine_workspace *ws, double **M_yx, mine_score *score,
+                 double *bound, double *mic)
+{
+  int i = k/2, j, x, s;
+  double tau = ws->plan->opt.screen_tau;
+  double mic_curr = 0.0, row_max = 0.0, fill, *M_row;
+
+  M_row = (k % 2 == 0) ? score->M[i] : M_yx[i];
+  x = row_cols(ws->plan, i);
+
+  /*
+   * with EST_MIC_E* the diagonal of x vs. y is replaced by y vs. x, so
+   * OptimizeXAxisE() does not compute it (none of the row 0)
+   */
+  if ((ws->plan->param.est == EST_MIC_E_CLUMP) && (k % 2 == 0) &&
+      (x == i+2))
+    x = i+1;
+
+  if (x < 2)
+    return;
+
+  if (bound != NULL)
+    {
+#ifdef _OPENMP
+      #pragma omp critical (mine_row_mic)
+#endif
+      mic_curr = *mic;
+
+      fill = -1.0;
+      if ((tau > 0.0) && (mic_curr >= tau))
+        fill = 0.0;
+      else if (bound[k] + BOUND_TOL < tau)
+        fill = bound[k] + BOUND_TOL;
+      else if (bound[k] + BOUND_TOL <= mic_curr)
+        fill = 0.0;
+
+      if (fill >= 0.0)
+        {
+          for (j=0; j<x-1; j++)
+            M_row[j] = fill;
+          return;
+        }
+    }
+
+  if (k % 2 == 0) /* x vs. y */
+    compute_score_row(px, py, i, x, ws, M_row);
+  else /* y vs. x */
+    compute_score_row(py, px, i, x, ws, M_row);
+
+  if (bound != NULL)
+    {
+      /* with EST_MIC_E* the diagonal of x vs. y is replaced by y vs. x */
+      s = x-1;
+      if ((ws->plan->param.est != EST_MIC_APPROX) && (k % 2 == 0))
+        s = MIN(i, s);
+
+      for (j=0; j<s; j++)
+        row_max = MAX(M_row[j], row_max);
+
+#ifdef _OPENMP
+      #pragma omp critical (mine_row_mic)
+#endif
+      *mic = MAX(row_max, *mic);
+    }
+}
+
+
+/*
+ * Returns TRUE if the row i of the characteristic matrix may have at least
+ * min_parallel_clumps clumps and more than one thread is requested.
+ */
+int large_row(mine_plan *plan, int i)
+{
+  int p;
+
+  p = MIN(row_superclumps(plan, i), plan->n);
+
+  return (get_num_threads(&plan->opt) > 1) &&
+    (p >= plan->opt.min_parallel_clumps);
+}
+
+
+/*
+ * Computes the (equi)characteristic matrix of the prepared variables px and
+ * py into score, allocated with the shape of the plan of the workspaces ws.
+ *
+ * The 2*score->n rows of x vs. y and y vs. x are independent, so they are
+ * spread among num_threads threads, the thread k using the workspace ws[k].
+ * The large rows (see large_row()) are computed before, using ws[0].
+ * The rows of y vs. x are stored in ws[0] and merged into score at the end,
+ * therefore the result does not depend on the number of threads.
+ *
+ * If only the MIC is requested (see mic_only()) the rows are computed in
+ * order by decreasing upper bound (see row_bound()) and a row is skipped
+ * (set to 0) if its bound does not exceed the maximum score found so far.
+ * The skipped scores are not greater than the MIC, so the MIC is the same
+ * as with all the rows, while the other statistics are not meaningful.
+ * With a screening threshold (see compute_row()) the computation stops as
+ * soon as MIC >= tau is found or the bounds of the remaining rows are
+ * below tau: then the MIC of score is a lower bound of the MIC if it is
+ * >= tau, an upper bound otherwise.
+ *
+ * Returns 0 on success, 1 if an error occurs.
+ */
+int compute_score_plan(mine_prepared *px, mine_prepared *py,
+                       mine_workspace **ws, int num_threads,
+                       mine_score *score)
+{
+  int i, j, k, n;
+  int *order = ws[0]->row_order;
+  double mic = 0.0, *bound = NULL;
+  double **M_yx = ws[0]->M_yx;
+  mine_plan *plan = ws[0]->plan;
+
+  n = plan->n;
+
+  /* the variables must be prepared for the plan */
+  if ((px->n != n) || (py->n != n) || (px->nq != score->n) ||
+      (py->nq != score->n) || (score->n != plan->score_n))
+    return 1;
+
+  for (k=0; k<2*score->n; k++)
+    order[k] = k;
+
+  if (mic_only(plan))
+    {
+      bound = ws[0]->row_bound;
+
+#ifdef _OPENMP
+      #pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads) \
+        if (num_threads > 1)
+#endif
+      for (k=0; k<2*score->n; k++)
+        {
+          int tid = 0;
+
+#ifdef _OPENMP
+          tid = omp_get_thread_num();
+#endif
+
+          if (k % 2 == 0) /* x vs. y */
+            bound[k] = row_bound(px, py, k/2, ws[tid]);
+          else /* y vs. x */
+            bound[k] = row_bound(py, px, k/2, ws[tid]);
+        }
+
+      sort_rows(bound, order, 2*score->n);
+    }
+
+  /*
+   * The rows with many clumps are computed one at a time, each one spread
+   * among the threads by OptimizeXAxis() (see min_parallel_clumps)
+   */
+  for (k=0; k<2*score->n; k++)
+    if (large_row(plan, order[k]/2))
+      compute_row(px, py, order[k], ws[0], M_yx, score, bound, &mic);
+
+  /*
+   * The first rows are the most expensive (more columns and more clumps),
+   * so they are handed out first, x vs. y and y vs. x alternated.
+   */
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads) \
+    if (num_threads > 1)
+#endif
+  for (k=0; k<2*score->n; k++)
+    {
+      int tid = 0;
+
+#ifdef _OPENMP
+      tid = omp_get_thread_num();
+#endif
+
+      if (large_row(plan, order[k]/2))
+        continue;
+
+      compute_row(px, py, order[k], ws[tid], M_yx, score, bound, &mic);
+    }
+
+  /* merge */
+  for (i=0; i<score->n; i++)
+    {
+      if (plan->param.est == EST_MIC_APPROX)
+        for (j=0; j<score->m[i]; j++)
+          score->M[j][i] = MAX(M_yx[i][j], score->M[j][i]);
+      else /* EST_MIC_E, EST_MIC_E_CLUMP */
+        for (j=0; j<MIN(i+1, score->m[i]); j++)
+          score->M[j][i] = M_yx[i][j];
+    }
+
+  return 0;
+}
+
+
+/*
+ * Prepares the variables of prob into ws->px and ws->py, sorting with the
+ * threads of the plan. Returns 0 on success, 1 if an error occurs.
+ */
+int prepare_problem(mine_problem *prob, mine_workspace *ws)
+{
+  if (prob->n != ws->plan->n)
+    return 1;
+
+  if (prepare(prob->x, &ws->px, ws->keys, ws->keys_tmp, ws->idx_tmp,
+              ws->Q_map, ws->radix_offs, ws->radix_threads))
+    return 1;
+
+  if (prepare(prob->y, &ws->py, ws->keys, ws->keys_tmp, ws->idx_tmp,
+              ws->Q_map, ws->radix_offs, ws->radix_threads))
+    return 1;
+
+  return 0;
+}
+
+
+/* See mine.h */
+int mine_compute_score_ws(mine_problem *prob, mine_workspace *ws,
+                          mine_score *score)
+{
+  if (prepare_problem(prob, ws))
+    return 1;
+
+  return compute_score_plan(&ws->px, &ws->py, &ws, 1, score);
+}
+
+
+/* Frees the first n workspaces of ws and ws itself */
+void free_workspaces(mine_workspace **ws, int n)
+{
+  int i;
+
+  for (i=0; i<n; i++)
+    mine_free_workspace(&ws[i]);
+  free(ws);
+}
+
+
+/*
+ * Computes the score of the problem prob (if px and py are NULL) or of the
+ * prepared variables px and py, using a temporary plan and one workspace for
+ * each thread (see compute_score_plan()). Returns NULL if an error occurs.
+ */
+mine_score *compute_score(mine_problem *prob, mine_prepared *px,
+                          mine_prepared *py, mine_parameter *param,
+                          mine_options *opt)
+{
+  int i, n, num_threads;
+  mine_plan *plan;
+  mine_workspace **ws;
+  mine_score *score;
+
+  n = (prob != NULL) ? prob->n : px->n;
+
+  plan = mine_create_plan(n, param, opt);
+  if (plan == NULL)
+    goto error_plan;
+
+  /* there are 2*score_n rows to compute */
+  num_threads = MIN(get_num_threads(&plan->opt), 2*plan->score_n);
+
+  ws = (mine_workspace **) malloc (num_threads * sizeof(mine_workspace *));
+  if (ws == NULL)
+    goto error_ws;
+
+  for (i=0; i<num_threads; i++)
+    {
+      ws[i] = mine_create_workspace(plan);
+      if (ws[i] == NULL)
+        {
+          free_workspaces(ws, i);
+          goto error_ws;
+        }
+    }
+
+  score = mine_alloc_score(plan);
+  if (score == NULL)
+    goto error_score;
+
+  if (prob != NULL)
+    {
+      /* the prepared variables are stored in the first workspace */
+      if (prepare_problem(prob, ws[0]))
+        goto error_compute;
+
+      px = &ws[0]->px;
+      py = &ws[0]->py;
+    }
+
+  if (compute_score_plan(px, py, ws, num_threads, score))
+    goto error_compute;
+
+  free_workspaces(ws, num_threads);
+  mine_free_plan(&plan);
+
+  return score;
+
+  error_compute:
+    mine_free_score(&score);
+  error_score:
+    free_workspaces(ws, num_threads);
+  error_ws:
+    mine_free_plan(&plan);
+  error_plan:
+    return NULL;
+}
+
+
+/* See mine.h */
+mine_score *mine_compute_score(mine_problem *prob, mine_parameter *param)
+{
+  return compute_score(prob, NULL, NULL, param, NULL);
+}
+
+
+/* See mine.h */
+mine_score *mine_compute_score_opt(mine_problem *prob, mine_parameter *param,
+                                   mine_options *opt)
+{
+  return compute_score(prob, NULL, NULL, param, opt);
+}
+
+
+/* See mine.h */
+mine_score *mine_compute_score_prepared(mine_prepared *px, mine_prepared *py,
+                                        mine_parameter *param)
+{
+  return compute_score(NULL, px, py, param, NULL);
+}
+
+
+/* See mine.h */
+char *mine_check_parameter(mine_parameter *param)
+{
+  if (((param->alpha <= 0.0) || (param->alpha > 1.0)) && (param->alpha < 4.0))
+    return "alpha must be in (0.0, 1.0] or >= 4.0";
+
+  if (param->c <= 0.0)
+    return "c must be > 0.0";
+
+  if ((param->est != EST_MIC_APPROX) && (param->est != EST_MIC_E) &&
+      (param->est != EST_MIC_E_CLUMP))
+    return "unknown estimator";
+
+  return NULL;
+}
+
+
+/* See mine.h */
+double mine_mic(mine_score *score)
+{
+  int i, j;
+  double score_max = 0.0;
+
+  for (i=0; i<score->n; i++)
+    for (j=0; j<score->m[i]; j++)
+      if (score->M[i][j] > score_max)
+        score_max = score->M[i][j];
+
+  return score_max;
+}
+
+
+/* See mine.h */
+double mine_mas(mine_score *score)
+{
+  int i, j;
+  double score_curr;
+  double score_max = 0.0;
+
+  for (i=0; i<score->n; i++)
+    for (j=0; j<score->m[i]; j++)
+      {
+        score_curr = fabs(score->M[i][j] - score->M[j][i]);
+        if (score_curr > score_max)
+          score_max = score_curr;
+      }
+
+  return score_max;
+}
+
+
+/* See mine.h */
+double mine_mev(mine_score *score)
+{
+  int i, j;
+  double score_max = 0.0;
+
+  for (i=0; i<score->n; i++)
+    for (j=0; j<score->m[i]; j++)
+      if (((j==0) || (i==0)) && score->M[i][j] > score_max)
+        score_max = score->M[i][j];
+
+  return score_max;
+}
+
+
+/* See mine.h */
+double mine_mcn(mine_score *score, double eps)
+{
+  int i, j;
+  double log_xy;
+  double score_min = DBL_MAX;
+  double delta = 0.0001; /* avoids overestimation of mcn */
+  double mic = mine_mic(score);
+
+  for (i=0; i<score->n; i++)
+    for (j=0; j<score->m[i]; j++)
+      {
+        log_xy = log((i+2) * (j+2)) / log(2.0);
+        if (((score->M[i][j]+delta) >= ((1.0 - eps) * mic))
+             && (log_xy < score_min))
+          score_min = log_xy;
+      }
+
+  return score_min;
+}
+
+
+/* See mine.h */
+double mine_mcn_general(mine_score *score)
+{
+  int i, j;
+  double log_xy;
+  double score_min = DBL_MAX;
+  double delta = 0.0001; /* avoids overestimation of mcn */
+  double mic = mine_mic(score);
+
+  for (i=0; i<score->n; i++)
+    for (j=0; j<score->m[i]; j++)
+      {
+        log_xy = log((i+2) * (j+2)) / log(2.0);
+        if (((score->M[i][j]+delta) >= (mic * mic)) && (log_xy < score_min))
+          score_min = log_xy;
+      }
+
+  return score_min;
+}
+
+/* See mine.h */
+double mine_tic(mine_score *score, int norm)
+{
+  int i, j, k=0;
+  double tic = 0.0;
+
+  for (i=0; i<score->n; i++)
+    for (j=0; j<score->m[i]; j++)
+      {
+        tic += score->M[i][j];
+        k++;
+      }
+
+  if (norm)
+    tic /= k;
+
+  return tic;
+}
+
+/* See mine.h */
+double mine_gmic(mine_score *score, double p)
+{
+  int i, j, Z, B_max = 0;
+  double *C, gmic;
+
+  /*
+   * C_star[i][j] is the MIC of the sub-score with B = (i+2)(j+2), i.e. the
+   * maximum of M over the cells (a, b) with (a+2)(b+2) <= (i+2)(j+2). C[B]
+   * is first the maximum of M over the cells of size B, then the prefix
+   * maximum over the sizes, so that C_star[i][j] = C[(i+2)(j+2)].
+   */
+  for (i=0; i<score->n; i++)
+    B_max = MAX((i+2) * (score->m[i]+1), B_max);
+
+  C = (double *) malloc ((B_max+1) * sizeof(double));
+  if (C == NULL)
+    return NAN;
+
+  for (i=0; i<=B_max; i++)
+    C[i] = 0.0;
+
+  for (i=0; i<score->n; i++)
+    for (j=0; j<score->m[i]; j++)
+      C[(i+2) * (j+2)] = MAX(score->M[i][j], C[(i+2) * (j+2)]);
+
+  for (i=1; i<=B_max; i++)
+    C[i] = MAX(C[i-1], C[i]);
+
+  /* p=0 -> geometric mean */
+  if (p == 0.0)
+    {
+      Z = 0;
+      gmic = 1.0;
+      for (i=0; i<score->n; i++)
+        for (j=0; j<score->m[i]; j++)
+          {
+            gmic *= C[(i+2) * (j+2)];
+            Z++;
+          }
+      gmic = pow(gmic, (double) Z);
+    }
+  /* p!=0 -> generalized mean */
+  else
+    {
+      Z = 0;
+      gmic = 0.0;
+      for (i=0; i<score->n; i++)
+        for (j=0; j<score->m[i]; j++)
+          {
+            gmic += pow(C[(i+2) * (j+2)], p);
+            Z++;
+          }
+      gmic /= (double) Z;
+      gmic = pow(gmic, 1.0/p);
+    }
+
+  free(C);
+
+  return gmic;
+}
+
+
+/*
+ * As mine_all_stats(), computing only the statistics in mask (STAT_* flags,
+ * see mine_options). The other fields of stats are undefined.
+ */
+void compute_stats(mine_score *score, int mask, double eps, double p,
+                   mine_stats *stats)
+{
+  int i, j, k = 0;
+  double log_xy, thr, thr_general;
+  double mic = 0.0, mas = 0.0, mev = 0.0, tic = 0.0;
+  double mcn = DBL_MAX, mcn_general = DBL_MAX;
+  double delta = 0.0001; /* avoids overestimation of mcn, see mine_mcn() */
+
+  /* MIC, MAS, MEV and TIC in a single pass over the rows */
+  for (i=0; i<score->n; i++)
+    for (j=0; j<score->m[i]; j++)
+      {
+        mic = MAX(score->M[i][j], mic);
+        tic += score->M[i][j];
+        k++;
+
+        if ((i == 0) || (j == 0))
+          mev = MAX(score->M[i][j], mev);
+
+        /* |M[i][j] - M[j][i]| is symmetric */
+        if (j > i)
+          mas = MAX(fabs(score->M[i][j] - score->M[j][i]), mas);
+      }
+
+  /*
+   * MCN and MCN_general need MIC. In each row the grid size grows with j,
+   * so only the first cell above the threshold is needed.
+   */
+  thr = (1.0 - eps) * mic;
+  thr_general = mic * mic;
+  for (i=0; i<score->n && (mask & (STAT_MCN | STAT_MCN_GENERAL)); i++)
+    {
+      for (j=0; j<score->m[i]; j++)
+        if ((score->M[i][j]+delta) >= thr)
+          {
+            log_xy = log((i+2) * (j+2)) / log(2.0);
+            mcn = MIN(log_xy, mcn);
+            break;
+          }
+
+      for (j=0; j<score->m[i]; j++)
+        if ((score->M[i][j]+delta) >= thr_general)
+          {
+            log_xy = log((i+2) * (j+2)) / log(2.0);
+            mcn_general = MIN(log_xy, mcn_general);
+            break;
+          }
+    }
+
+  stats->mic = mic;
+  stats->mas = mas;
+  stats->mev = mev;
+  stats->mcn = mcn;
+  stats->mcn_general = mcn_general;
+  stats->tic = tic;
+  stats->tic_norm = tic / k;
+  if (mask & STAT_GMIC)
+    stats->gmic = mine_gmic(score, p);
+}
+
+
+/* See mine.h */
+void mine_all_stats(mine_score *score, double eps, double p, mine_stats *stats)
+{
+  compute_stats(score, STAT_ALL, eps, p, stats);
+}
+
+
+/* See mine.h */
+void mine_free_score(mine_score **score)
+{
+  free(*score);
+  *score = NULL;
+}
+
+
+/* See mine.h */
+void mine_init_options(mine_options *opt)
+{
+  opt->num_threads = 1;
+  opt->max_hp2q_memory = MAX_HP2Q_MEMORY;
+  opt->min_parallel_clumps = MIN_PARALLEL_CLUMPS;
+  opt->interrupt = NULL;
+  opt->interrupt_data = NULL;
+  opt->stats = STAT_MIC | STAT_TIC;
+  opt->mcn_eps = 0.0;
+  opt->gmic_p = -1.0;
+  opt->screen_tau = 0.0;
+  opt->cascade_alpha = 0.0;
+  opt->cascade_tau = 0.0;
+  opt->cascade_quantile = 0.0;
+  opt->edge = NULL;
+  opt->edge_data = NULL;
+}
+
+
+/* number of STAT_* flags */
+#define STAT_NUM 7
+
+
+/*
+ * Sets out[s] to the address of the array of the statistic 1 << s (see the
+ * STAT_* flags) of a mine_pstats or mine_cstats.
+ */
+void stats_arrays(double **out[], double **mic, double **mas, double **mev,
+                  double **mcn, double **mcn_general, double **tic,
+                  double **gmic)
+{
+  out[0] = mic;
+  out[1] = mas;
+  out[2] = mev;
+  out[3] = mcn;
+  out[4] = mcn_general;
+  out[5] = tic;
+  out[6] = gmic;
+}
+
+
+/* Frees the arrays of the statistics and sets them to NULL */
+void free_stats_arrays(double **out[])
+{
+  int s;
+
+  for (s=0; s<STAT_NUM; s++)
+    {
+      free(*out[s]);
+      *out[s] = NULL;
+    }
+}
+
+
+/*
+ * Allocates the arrays of length len of the statistics in mask and sets the
+ * others to NULL. Returns 0 on success, 1 if an error occurs (all the arrays
+ * are then freed).
+ */
+int alloc_stats_arrays(double **out[], int mask, long len)
+{
+  int s;
+
+  for (s=0; s<STAT_NUM; s++)
+    *out[s] = NULL;
+
+  for (s=0; s<STAT_NUM; s++)
+    if (mask & (1 << s))
+      {
+        *out[s] = (double *) malloc (len * sizeof(double));
+        if (*out[s] == NULL)
+          {
+            free_stats_arrays(out);
+            return 1;
+          }
+      }
+
+  return 0;
+}
+
+
+/* Stores the statistics of the pair k in the allocated arrays */
+void store_stats(mine_stats *stats, double **out[], long k)
+{
+  int s;
+  double value[STAT_NUM];
+
+  value[0] = stats->mic;
+  value[1] = stats->mas;
+  value[2] = stats->mev;
+  value[3] = stats->mcn;
+  value[4] = stats->mcn_general;
+  value[5] = stats->tic_norm;
+  value[6] = stats->gmic;
+
+  for (s=0; s<STAT_NUM; s++)
+    if (*out[s] != NULL)
+      (*out[s])[k] = value[s];
+}
+
+
+/*
+ * Returns TRUE if the computation must be stopped, see mine_options. Only
+ * the master thread (the caller's thread) calls opt->interrupt.
+ */
+int interrupted(mine_options *opt)
+{
+  if (opt->interrupt == NULL)
+    return FALSE;
+
+#ifdef _OPENMP
+  if (omp_get_thread_num() != 0)
+    return FALSE;
+#endif
+
+  return opt->interrupt(opt->interrupt_data) != 0;
+}
+
+
+/*
+ * Reads the flag shared by the threads of a parallel loop (e.g. the error
+ * flag), which other threads may set at the same time. OpenMP < 3.1 has no
+ * atomic read and write, a critical section is used instead.
+ */
+int get_flag(int *flag)
+{
+  int value;
+
+#if defined(_OPENMP) && (_OPENMP >= 201107)
+  #pragma omp atomic read
+#elif defined(_OPENMP)
+  #pragma omp critical (mine_flag)
+#endif
+  value = *flag;
+
+  return value;
+}
+
+
+/* Sets the shared flag to TRUE, see get_flag() */
+void set_flag(int *flag)
+{
+#if defined(_OPENMP) && (_OPENMP >= 201107)
+  #pragma omp atomic write
+#elif defined(_OPENMP)
+  #pragma omp critical (mine_flag)
+#endif
+  *flag = TRUE;
+}
+
+
+/*
+ * Returns the pair (i, j), i < j < m, stored in the condensed index k. See
+ * the mine_pstats documentation.
+ */
+void condensed_to_pair(long k, int m, int *i, int *j)
+{
+  long a, b;
+  double d;
+
+  d = (double) (2*m - 1);
+  a = (long) floor((d - sqrt(d*d - 8.0*(double) k)) / 2.0);
+  a = MAX(a, 0);
+
+  /* fix rounding errors, b is the first condensed index of row a */
+  b = m*a - (a*(a+1))/2;
+  while (b > k)
+    {
+      --a;
+      b = m*a - (a*(a+1))/2;
+    }
+  while ((m*(a+1) - ((a+1)*(a+2))/2) <= k)
+    {
+      ++a;
+      b = m*a - (a*(a+1))/2;
+    }
+
+  *i = (int) a;
+  *j = (int) (k - b + a + 1);
+}
+
+
+/* Frees the first n prepared variables of prep and prep itself */
+void free_prepared_matrix(mine_prepared **prep, int n)
+{
+  int i;
+
+  for (i=0; i<n; i++)
+    mine_free_prepared(&prep[i]);
+  free(prep);
+}
+
+
+/*
+ * Prepares each variable (row) i of X, if used is NULL or used[i] is TRUE,
+ * using the threads of opt. The variables not used are NULL. Returns NULL
+ * if an error occurs or the computation is interrupted (see interrupted()).
+ */
+mine_prepared **prepare_matrix(mine_matrix *X, mine_parameter *param,
+                               char *used, mine_options *opt)
+{
+  int i, error = FALSE;
+  mine_prepared **prep;
+
+  prep = (mine_prepared **) malloc (X->n * sizeof(mine_prepared *));
+  if (prep == NULL)
+    return NULL;
+
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic, 1) \
+    num_threads(get_num_threads(opt))
+#endif
+  for (i=0; i<X->n; i++)
+    {
+      prep[i] = NULL;
+      if ((used != NULL) && !used[i])
+        continue;
+
+      if (get_flag(&error) || interrupted(opt))
+        {
+          set_flag(&error);
+          continue;
+        }
+
+      prep[i] = mine_prepare(&X->data[(long) i * X->m], X->m, param);
+      if (prep[i] == NULL)
+        set_flag(&error);
+    }
+
+  if (error)
+    {
+      free_prepared_matrix(prep, X->n);
+      return NULL;
+    }
+
+  return prep;
+}
+
+
+/* See mine.h */
+mine_pstats *mine_compute_pstats(mine_matrix *X, mine_parameter *param)
+{
+  mine_options opt;
+
+  mine_init_options(&opt);
+
+  return mine_compute_pstats_opt(X, param, &opt);
+}
+
+
+/*
+ * Consumer of the statistics of the pairs computed by compute_pstats(), used
+ * instead of the arrays out. store() is called by the thread t, 0 <= t <
+ * get_num_threads(opt), for the pair (i, j) and returns nonzero to stop the
+ * computation with an error.
+ */
+typedef struct pair_sink
+{
+  int (*store)(struct pair_sink *sink, int t, int i, int j,
+               mine_stats *stats);
+  void *data;
+} pair_sink;
+
+
+/*
+ * Computes the statistics in opt->stats of npairs pairs of variables of X
+ * into out (see stats_arrays()), or passes them to sink if it is not NULL.
+ * If pairs is not NULL, the pair k is (pairs[2*k], pairs[2*k+1]) and its
+ * statistics are stored at k. Otherwise the pair k is the condensed index
+ * index[k] (k if index is NULL, see mine_pstats) and its statistics are
+ * stored at that index. Only the variables of the pairs are prepared.
+ * Returns 0 on success, 1 if an error occurs.
+ */
+int compute_pstats(mine_matrix *X, mine_parameter *param, mine_options *opt,
+                   int *pairs, long *index, long npairs, double **out[],
+                   pair_sink *sink)
+{
+  long k;
+  int num_threads, error = FALSE;
+  char *used = NULL;
+  mine_plan *plan;
+  mine_prepared **prep;
+
+  num_threads = get_num_threads(opt);
+
+  /* all the pairs share the same plan */
+  plan = mine_create_plan(X->m, param, opt);
+  if (plan == NULL)
+    return 1;
+
+  if ((pairs != NULL) || (index != NULL))
+    {
+      used = (char *) calloc (X->n, sizeof(char));
+      if (used == NULL)
+        {
+          mine_free_plan(&plan);
+          return 1;
+        }
+
+      if (pairs != NULL)
+        for (k=0; k<2*npairs; k++)
+          used[pairs[k]] = TRUE;
+      else
+        for (k=0; k<npairs; k++)
+          {
+            int i, j;
+
+            condensed_to_pair(index[k], X->n, &i, &j);
+            used[i] = used[j] = TRUE;
+          }
+    }
+
+  /* each variable is sorted and equipartitioned only once */
+  prep = prepare_matrix(X, param, used, opt);
+  free(used);
+  if (prep == NULL)
+    {
+      mine_free_plan(&plan);
+      return 1;
+    }
+
+#ifdef _OPENMP
+  #pragma omp parallel num_threads(num_threads)
+#endif
+  {
+    int t = 0;
+    mine_workspace *ws;
+    mine_score *score;
+    mine_stats pair_stats;
+
+#ifdef _OPENMP
+    t = omp_get_thread_num();
+#endif
+
+    /* each thread reuses its workspace and score for all its pairs */
+    ws = mine_create_workspace(plan);
+    score = mine_alloc_score(plan);
+    if ((ws == NULL) || (score == NULL))
+      set_flag(&error);
+
+    /*
+     * The cost of a pair depends on the number of clumps, so the pairs are
+     * handed out one at a time to the first idle thread.
+     */
+#ifdef _OPENMP
+    #pragma omp for schedule(dynamic, 1)
+#endif
+    for (k=0; k<npairs; k++)
+      {
+        int i, j;
+        long kk = (index != NULL) ? index[k] : k;
+
+        if (get_flag(&error) || interrupted(opt))
+          {
+            set_flag(&error);
+            continue;
+          }
+
+        if (pairs != NULL)
+          {
+            i = pairs[2*k];
+            j = pairs[2*k+1];
+          }
+        else
+          condensed_to_pair(kk, X->n, &i, &j);
+
+        if (compute_score_plan(prep[i], prep[j], &ws, 1, score))
+          {
+            set_flag(&error);
+            continue;
+          }
+
+        compute_stats(score, opt->stats, opt->mcn_eps, opt->gmic_p,
+                      &pair_stats);
+        if (sink == NULL)
+          store_stats(&pair_stats, out, kk);
+        else if (sink->store(sink, t, i, j, &pair_stats))
+          set_flag(&error);
+      }
+
+    if (score != NULL)
+      mine_free_score(&score);
+    mine_free_workspace(&ws);
+  }
+
+  free_prepared_matrix(prep, X->n);
+  mine_free_plan(&plan);
+
+  return error;
+}
+
+
+/* Returns TRUE if x < y, NaN being less than any number */
+int less_double(double x, double y)
+{
+  if (x != x)
+    return y == y;
+
+  return x < y;
+}
+
+
+/*
+ * Returns the value at k of the n values a sorted in increasing order (see
+ * less_double()), in O(n) average time (quickselect). a is partially
+ * sorted.
+ */
+double select_double(double *a, long n, long k)
+{
+  long lo = 0, hi = n-1, i, j;
+  double pivot, tmp;
+
+  while (lo < hi)
+    {
+      pivot = a[lo + (hi-lo)/2];
+      i = lo;
+      j = hi;
+      while (i <= j)
+        {
+          while (less_double(a[i], pivot))
+            i++;
+          while (less_double(pivot, a[j]))
+            j--;
+          if (i <= j)
+            {
+              tmp = a[i];
+              a[i++] = a[j];
+              a[j--] = tmp;
+            }
+        }
+
+      /* a[lo..j] <= pivot <= a[i..hi] and a[j+1..i-1] = pivot */
+      if (k <= j)
+        hi = j;
+      else if (k >= i)
+        lo = i;
+      else
+        break;
+    }
+
+  return a[k];
+}
+
+
+/*
+ * Returns the threshold of the second stage of the cascade given the n
+ * values of the first stage (see mine_options.cascade_alpha). Returns NaN
+ * if an error occurs.
+ */
+double cascade_threshold(double *values, long n, mine_options *opt)
+{
+  double t = opt->cascade_tau, *tmp;
+
+  if ((opt->cascade_quantile <= 0.0) || (n == 0))
+    return t;
+
+  tmp = (double *) malloc (n * sizeof(double));
+  if (tmp == NULL)
+    return NAN;
+
+  memcpy(tmp, values, n * sizeof(double));
+  t = MAX(select_double(tmp, n, (long) (MIN(opt->cascade_quantile, 1.0) *
+                                        (n-1))), t);
+
+  free(tmp);
+
+  return t;
+}
+
+
+/*
+ * Two-stage mine_compute_pstats_opt() (see mine_options.cascade_alpha): the
+ * TIC_e of all the pairs is stored into stats->tic_e, then the statistics
+ * in out are computed for the selected pairs only. Returns 0 on success, 1
+ * if an error occurs (stats->tic_e must be freed by the caller).
+ */
+int compute_pstats_cascade(mine_matrix *X, mine_parameter *param,
+                           mine_options *opt, mine_pstats *stats,
+                           double **out[])
+{
+  int s, ret;
+  long k, nsel, npairs = stats->n, *pairs;
+  double t, *unused[STAT_NUM], **out_e[STAT_NUM];
+  mine_parameter param_e;
+  mine_options opt_e;
+
+  /* stage 1: normalized TIC_e with B given by cascade_alpha */
+  param_e.alpha = opt->cascade_alpha;
+  param_e.c = param->c;
+  param_e.est = EST_MIC_E_CLUMP;
+
+  opt_e = *opt;
+  opt_e.stats = STAT_TIC;
+
+  stats->tic_e = (double *) malloc (npairs * sizeof(double));
+  if (stats->tic_e == NULL)
+    return 1;
+
+  stats_arrays(out_e, &unused[0], &unused[1], &unused[2], &unused[3],
+               &unused[4], &stats->tic_e, &unused[6]);
+  for (s=0; s<STAT_NUM; s++)
+    unused[s] = NULL;
+
+  if (compute_pstats(X, &param_e, &opt_e, NULL, NULL, npairs, out_e,
+                     NULL))
+    return 1;
+
+  /* stage 2: the statistics of the pairs above the threshold */
+  t = cascade_threshold(stats->tic_e, npairs, opt);
+  if (t != t)
+    return 1;
+
+  pairs = (long *) malloc (npairs * sizeof(long));
+  if (pairs == NULL)
+    return 1;
+
+  for (k=0, nsel=0; k<npairs; k++)
+    if (stats->tic_e[k] >= t)
+      pairs[nsel++] = k;
+
+  for (s=0; s<STAT_NUM; s++)
+    if (*out[s] != NULL)
+      for (k=0; k<npairs; k++)
+        (*out[s])[k] = NAN;
+
+  ret = compute_pstats(X, param, opt, NULL, pairs, nsel, out, NULL);
+
+  free(pairs);
+
+  return ret;
+}
+
+
+/* See mine.h */
+mine_pstats *mine_compute_pstats_opt(mine_matrix *X, mine_parameter *param,
+                                     mine_options *opt)
+{
+  long npairs;
+  mine_pstats *stats;
+  double **out[STAT_NUM];
+
+  /* Allocate memory for stats */
+  stats = (mine_pstats *) malloc(sizeof(mine_pstats));
+  if (stats == NULL)
+    goto error_stats;
+
+  npairs = ((long) X->n * (long) (X->n-1)) / 2;
+  stats->n = npairs;
+  stats->tic_e = NULL;
+
+  /* only the requested statistics are allocated */
+  stats_arrays(out, &stats->mic, &stats->mas, &stats->mev, &stats->mcn,
+               &stats->mcn_general, &stats->tic, &stats->gmic);
+  if (alloc_stats_arrays(out, opt->stats, npairs))
+    goto error_arrays;
+
+  if (opt->cascade_alpha > 0.0)
+    {
+      if (compute_pstats_cascade(X, param, opt, stats, out))
+        goto error_compute;
+    }
+  else if (compute_pstats(X, param, opt, NULL, NULL, npairs, out, NULL))
+    goto error_compute;
+
+  return stats;
+
+  error_compute:
+    free(stats->tic_e);
+    free_stats_arrays(out);
+  error_arrays:
+    free(stats);
+  error_stats:
+    return NULL;
+}
+
+
+/* See mine.h */
+void mine_free_pstats(mine_pstats **stats)
+{
+  double **out[STAT_NUM];
+  mine_pstats *stats_ptr = *stats;
+
+  if (stats_ptr != NULL)
+    {
+      stats_arrays(out, &stats_ptr->mic, &stats_ptr->mas, &stats_ptr->mev,
+                   &stats_ptr->mcn, &stats_ptr->mcn_general, &stats_ptr->tic,
+                   &stats_ptr->gmic);
+      free_stats_arrays(out);
+      free(stats_ptr->tic_e);
+      free(stats_ptr);
+      *stats = NULL;
+    }
+}
+
+
+/* See mine.h */
+mine_pstats *mine_compute_pairs(mine_matrix *X, int *pairs, long npairs,
+                                mine_parameter *param)
+{
+  mine_options opt;
+
+  mine_init_options(&opt);
+
+  return mine_compute_pairs_opt(X, pairs, npairs, param, &opt);
+}
+
+
+/* See mine.h */
+mine_pstats *mine_compute_pairs_opt(mine_matrix *X, int *pairs, long npairs,
+                                    mine_parameter *param, mine_options *opt)
+{
+  long k;
+  mine_pstats *stats;
+  double **out[STAT_NUM];
+
+  for (k=0; k<2*npairs; k++)
+    if ((pairs[k] < 0) || (pairs[k] >= X->n))
+      goto error_stats;
+
+  stats = (mine_pstats *) malloc(sizeof(mine_pstats));
+  if (stats == NULL)
+    goto error_stats;
+
+  stats->n = npairs;
+  stats->tic_e = NULL;
+
+  stats_arrays(out, &stats->mic, &stats->mas, &stats->mev, &stats->mcn,
+               &stats->mcn_general, &stats->tic, &stats->gmic);
+  if (alloc_stats_arrays(out, opt->stats, npairs))
+    goto error_arrays;
+
+  if (compute_pstats(X, param, opt, pairs, NULL, npairs, out, NULL))
+    goto error_compute;
+
+  return stats;
+
+  error_compute:
+    free_stats_arrays(out);
+  error_arrays:
+    free(stats);
+  error_stats:
+    return NULL;
+}
+
+
+/* A neighbor of a variable in mine_compute_topk_opt() */
+typedef struct topk_entry
+{
+  double mic;
+  double tic;
+  int index;
+} topk_entry;
+
+
+/*
+ * The heaps of mine_compute_topk_opt(): for each thread t and variable i, a
+ * heap of at most k neighbors starting at entry[(t*n + i) * k] holds
+ * count[t*n + i] entries, the worst one first (see topk_worse()).
+ */
+typedef struct topk_heaps
+{
+  int n;
+  int k;
+  topk_entry *entry;
+  int *count;
+} topk_heaps;
+
+
+/*
+ * Returns TRUE if the neighbor a ranks after b: lower MIC (NaN last) or, for
+ * the same MIC, higher index.
+ */
+int topk_worse(topk_entry *a, topk_entry *b)
+{
+  int a_nan = a->mic != a->mic, b_nan = b->mic != b->mic;
+
+  if (a_nan != b_nan)
+    return a_nan;
+
+  if (!a_nan && (a->mic != b->mic))
+    return a->mic < b->mic;
+
+  return a->index > b->index;
+}
+
+
+/* Restores the heap property of the count entries of heap below r */
+void topk_sift_down(topk_entry *heap, int count, int r)
+{
+  int c;
+  topk_entry tmp;
+
+  while ((c = 2*r + 1) < count)
+    {
+      if ((c+1 < count) && topk_worse(&heap[c+1], &heap[c]))
+        c++;
+
+      if (!topk_worse(&heap[c], &heap[r]))
+        break;
+
+      tmp = heap[r];
+      heap[r] = heap[c];
+      heap[c] = tmp;
+      r = c;
+    }
+}
+
+
+/*
+ * Inserts e into the heap of at most k entries, replacing the worst one if
+ * the heap is full and e ranks before it.
+ */
+void topk_push(topk_entry *heap, int *count, int k, topk_entry *e)
+{
+  int c, r;
+
+  if (*count < k)
+    {
+      /* sift up */
+      for (c=(*count)++; c>0; c=r)
+        {
+          r = (c-1) / 2;
+          if (!topk_worse(e, &heap[r]))
+            break;
+          heap[c] = heap[r];
+        }
+      heap[c] = *e;
+    }
+  else if (topk_worse(&heap[0], e))
+    {
+      heap[0] = *e;
+      topk_sift_down(heap, k, 0);
+    }
+}
+
+
+/*
+ * pair_sink.store() of mine_compute_topk_opt(): j is a neighbor of i and
+ * vice versa.
+ */
+int topk_store(pair_sink *sink, int t, int i, int j, mine_stats *stats)
+{
+  size_t h;
+  topk_entry e;
+  topk_heaps *heaps = (topk_heaps *) sink->data;
+
+  e.mic = stats->mic;
+  e.tic = stats->tic_norm;
+
+  h = (size_t) t * heaps->n + i;
+  e.index = j;
+  topk_push(&heaps->entry[h * heaps->k], &heaps->count[h], heaps->k, &e);
+
+  h = (size_t) t * heaps->n + j;
+  e.index = i;
+  topk_push(&heaps->entry[h * heaps->k], &heaps->count[h], heaps->k, &e);
+
+  return 0;
+}
+
+
+/* See mine.h */
+mine_topk *mine_compute_topk(mine_matrix *X, mine_parameter *param, int k)
+{
+  mine_options opt;
+
+  mine_init_options(&opt);
+
+  return mine_compute_topk_opt(X, param, k, &opt);
+}
+
+
+/* See mine.h */
+mine_topk *mine_compute_topk_opt(mine_matrix *X, mine_parameter *param, int k,
+                                 mine_options *opt)
+{
+  int i, t, num_threads, error = FALSE;
+  long npairs;
+  size_t len;
+  mine_topk *topk;
+  mine_options opt_topk;
+  topk_heaps heaps;
+  pair_sink sink;
+
+  if (k < 1)
+    goto error_topk;
+
+  num_threads = get_num_threads(opt);
+
+  topk = (mine_topk *) malloc(sizeof(mine_topk));
+  if (topk == NULL)
+    goto error_topk;
+
+  topk->n = X->n;
+  topk->k = MAX(MIN(k, X->n - 1), 0);
+  len = MAX((size_t) topk->n * topk->k, 1);
+
+  topk->index = (int *) malloc (len * sizeof(int));
+  topk->mic = (double *) malloc (len * sizeof(double));
+  topk->tic = NULL;
+  if (opt->stats & STAT_TIC)
+    topk->tic = (double *) malloc (len * sizeof(double));
+  if ((topk->index == NULL) || (topk->mic == NULL) ||
+      ((opt->stats & STAT_TIC) && (topk->tic == NULL)))
+    goto error_arrays;
+
+  /* one heap per variable and thread, merged at the end */
+  heaps.n = topk->n;
+  heaps.k = topk->k;
+  heaps.entry = (topk_entry *) malloc (num_threads * len * sizeof(topk_entry));
+  if (heaps.entry == NULL)
+    goto error_arrays;
+
+  heaps.count = (int *) calloc ((size_t) num_threads * topk->n, sizeof(int));
+  if (heaps.count == NULL)
+    goto error_count;
+
+  sink.store = topk_store;
+  sink.data = &heaps;
+
+  /* only MIC (and TIC) are needed, the MIC is exact */
+  opt_topk = *opt;
+  opt_topk.stats = STAT_MIC | (opt->stats & STAT_TIC);
+  opt_topk.screen_tau = 0.0;
+
+  npairs = ((long) X->n * (long) (X->n-1)) / 2;
+  if (compute_pstats(X, param, &opt_topk, NULL, NULL, npairs, NULL, &sink))
+    goto error_compute;
+
+  /* merge the heaps of the threads into the first one, then sort it */
+#ifdef _OPENMP
+  #pragma omp parallel for private(t) schedule(static) num_threads(num_threads)
+#endif
+  for (i=0; i<topk->n; i++)
+    {
+      int c, r;
+      topk_entry tmp, *heap = &heaps.entry[(size_t) i * topk->k];
+
+      if (get_flag(&error) || interrupted(opt))
+        {
+          set_flag(&error);
+          continue;
+        }
+
+      for (t=1; t<num_threads; t++)
+        {
+          size_t h = (size_t) t * topk->n + i;
+
+          for (c=0; c<heaps.count[h]; c++)
+            topk_push(heap, &heaps.count[i], topk->k,
+                      &heaps.entry[h * topk->k + c]);
+        }
+
+      /* heapsort, the worst neighbor last */
+      for (c=heaps.count[i]-1; c>0; c--)
+        {
+          tmp = heap[0];
+          heap[0] = heap[c];
+          heap[c] = tmp;
+          topk_sift_down(heap, c, 0);
+        }
+
+      for (r=0; r<topk->k; r++)
+        {
+          size_t o = (size_t) i * topk->k + r;
+
+          topk->index[o] = heap[r].index;
+          topk->mic[o] = heap[r].mic;
+          if (topk->tic != NULL)
+            topk->tic[o] = heap[r].tic;
+        }
+    }
+
+  if (error)
+    goto error_compute;
+
+  free(heaps.count);
+  free(heaps.entry);
+
+  return topk;
+
+  error_compute:
+    free(heaps.count);
+  error_count:
+    free(heaps.entry);
+  error_arrays:
+    free(topk->tic);
+    free(topk->mic);
+    free(topk->index);
+    free(topk);
+  error_topk:
+    return NULL;
+}
+
+
+/* See mine.h */
+void mine_free_topk(mine_topk **topk)
+{
+  mine_topk *topk_ptr = *topk;
+
+  if (topk_ptr != NULL)
+    {
+      free(topk_ptr->index);
+      free(topk_ptr->mic);
+      free(topk_ptr->tic);
+      free(topk_ptr);
+      *topk = NULL;
+    }
+}
+
+
+/* See mine.h */
 mine_cstats *mine_compute_cstats(mine_matrix *X, mine_matrix *Y,
                                  mine_parameter *param)
 {
-  int i, j, k;
+  mine_options opt;
+
+  mine_init_options(&opt);
+
+  return mine_compute_cstats_opt(X, Y, param, &opt);
+}
+
+
+/*
+ * Computes the statistics in opt->stats of each pair of variables of X and
+ * Y into out (see stats_arrays()), the pair (i, j) at i*Y->n + j, or passes
+ * them to sink if it is not NULL (see compute_pstats()). Returns 0 on
+ * success, 1 if an error occurs.
+ */
+int compute_cstats(mine_matrix *X, mine_matrix *Y, mine_parameter *param,
+                   mine_options *opt, double **out[], pair_sink *sink)
+{
+  long k, npairs;
+  int num_threads, error = FALSE;
+  mine_plan *plan;
+  mine_prepared **prepx, **prepy;
+
+
+  num_threads = get_num_threads(opt);
+  npairs = (long) X->n * (long) Y->n;
+
+  plan = mine_create_plan(X->m, param, opt);
+  if (plan == NULL)
+    goto error_plan;
+
+  prepx = prepare_matrix(X, param, NULL, opt);
+  if (prepx == NULL)
+    goto error_prepx;
+
+  prepy = prepare_matrix(Y, param, NULL, opt);
+  if (prepy == NULL)
+    goto error_prepy;
+
+  /* see compute_pstats() */
+#ifdef _OPENMP
+  #pragma omp parallel num_threads(num_threads)
+#endif
+  {
+    int t = 0;
+    mine_workspace *ws;
+    mine_score *score;
+    mine_stats pair_stats;
+
+#ifdef _OPENMP
+    t = omp_get_thread_num();
+#endif
+
+    ws = mine_create_workspace(plan);
+    score = mine_alloc_score(plan);
+    if ((ws == NULL) || (score == NULL))
+      set_flag(&error);
+
+#ifdef _OPENMP
+    #pragma omp for schedule(dynamic, 1)
+#endif
+    for (k=0; k<npairs; k++)
+      {
+        int i = (int) (k / Y->n), j = (int) (k % Y->n);
+
+        if (get_flag(&error) || interrupted(opt))
+          {
+            set_flag(&error);
+            continue;
+          }
+
+        if (compute_score_plan(prepx[i], prepy[j], &ws, 1, score))
+          {
+            set_flag(&error);
+            continue;
+          }
+
+        compute_stats(score, opt->stats, opt->mcn_eps, opt->gmic_p,
+                      &pair_stats);
+        if (sink == NULL)
+          store_stats(&pair_stats, out, k);
+        else if (sink->store(sink, t, i, j, &pair_stats))
+          set_flag(&error);
+      }
+
+    if (score != NULL)
+      mine_free_score(&score);
+    mine_free_workspace(&ws);
+  }
+
+  free_prepared_matrix(prepy, Y->n);
+  free_prepared_matrix(prepx, X->n);
+  mine_free_plan(&plan);
+
+  return error;
+
+  error_prepy:
+    free_prepared_matrix(prepx, X->n);
+  error_prepx:
+    mine_free_plan(&plan);
+  error_plan:
+    return 1;
+}
+
+
+/* See mine.h */
+mine_cstats *mine_compute_cstats_opt(mine_matrix *X, mine_matrix *Y,
+                                     mine_parameter *param, mine_options *opt)
+{
   mine_cstats *stats;
-  mine_problem prob;
-  mine_score *score;
+  double **out[STAT_NUM];
 
 
   if (X->m != Y->m)
@@ -1281,27 +3405,423 @@ mine_cstats *mine_compute_cstats(mine_matrix *X, mine_matrix *Y,
 
   /* Allocate memory for stats */
   stats = (mine_cstats *) malloc(sizeof(mine_cstats));
+  if (stats == NULL)
+    goto error_stats;
+
   stats->n = X->n;
   stats->m = Y->n;
-  stats->mic = (double *) malloc((stats->n * stats->m) * sizeof(double));
-  stats->tic = (double *) malloc((stats->n * stats->m) * sizeof(double));
 
-  k = 0;
-  prob.n = X->m;
-  for (i=0; i<X->n; i++)
+  /* only the requested statistics are allocated */
+  stats_arrays(out, &stats->mic, &stats->mas, &stats->mev, &stats->mcn,
+               &stats->mcn_general, &stats->tic, &stats->gmic);
+  if (alloc_stats_arrays(out, opt->stats, (long) X->n * (long) Y->n))
+    goto error_arrays;
+
+  if (compute_cstats(X, Y, param, opt, out, NULL))
+    goto error_compute;
+
+  return stats;
+
+  error_compute:
+    free_stats_arrays(out);
+  error_arrays:
+    free(stats);
+  error_stats:
+    return NULL;
+}
+
+
+/* See mine.h */
+mine_cstats *mine_compute_one_vs_many(double *target, mine_matrix *X,
+                                      mine_parameter *param)
+{
+  mine_options opt;
+
+  mine_init_options(&opt);
+
+  return mine_compute_one_vs_many_opt(target, X, param, &opt);
+}
+
+
+/* See mine.h */
+mine_cstats *mine_compute_one_vs_many_opt(double *target, mine_matrix *X,
+                                          mine_parameter *param,
+                                          mine_options *opt)
+{
+  long k;
+  int error = FALSE;
+  mine_plan *plan;
+  mine_prepared *prept;
+  mine_cstats *stats;
+  double **out[STAT_NUM];
+
+  stats = (mine_cstats *) malloc(sizeof(mine_cstats));
+  if (stats == NULL)
+    goto error_stats;
+
+  stats->n = X->n;
+  stats->m = 1;
+
+  stats_arrays(out, &stats->mic, &stats->mas, &stats->mev, &stats->mcn,
+               &stats->mcn_general, &stats->tic, &stats->gmic);
+  if (alloc_stats_arrays(out, opt->stats, X->n))
+    goto error_arrays;
+
+  plan = mine_create_plan(X->m, param, opt);
+  if (plan == NULL)
+    goto error_plan;
+
+  /* the target is sorted and equipartitioned once for all the variables */
+  prept = mine_prepare(target, X->m, param);
+  if (prept == NULL)
+    goto error_prept;
+
+#ifdef _OPENMP
+  #pragma omp parallel num_threads(get_num_threads(opt))
+#endif
+  {
+    mine_workspace *ws;
+    mine_score *score;
+    mine_stats pair_stats;
+
+    ws = mine_create_workspace(plan);
+    score = mine_alloc_score(plan);
+    if ((ws == NULL) || (score == NULL))
+      set_flag(&error);
+
+    /* each variable is prepared into the workspace, right before its use */
+#ifdef _OPENMP
+    #pragma omp for schedule(dynamic, 1)
+#endif
+    for (k=0; k<X->n; k++)
+      {
+        if (get_flag(&error) || interrupted(opt))
+          {
+            set_flag(&error);
+            continue;
+          }
+
+        if (prepare(&X->data[k * X->m], &ws->px, ws->keys, ws->keys_tmp,
+                    ws->idx_tmp, ws->Q_map, NULL, 1))
+          {
+            set_flag(&error);
+            continue;
+          }
+
+        if (compute_score_plan(&ws->px, prept, &ws, 1, score))
+          {
+            set_flag(&error);
+            continue;
+          }
+
+        compute_stats(score, opt->stats, opt->mcn_eps, opt->gmic_p,
+                      &pair_stats);
+        store_stats(&pair_stats, out, k);
+      }
+
+    if (score != NULL)
+      mine_free_score(&score);
+    mine_free_workspace(&ws);
+  }
+
+  mine_free_prepared(&prept);
+  mine_free_plan(&plan);
+
+  if (error)
+    goto error_plan;
+
+  return stats;
+
+  error_prept:
+    mine_free_plan(&plan);
+  error_plan:
+    free_stats_arrays(out);
+  error_arrays:
+    free(stats);
+  error_stats:
+    return NULL;
+}
+
+
+/* An edge of mine_compute_*_edges_opt() */
+typedef struct edge_entry
+{
+  int i;
+  int j;
+  double mic;
+  double tic;
+} edge_entry;
+
+
+/*
+ * The edge buffers of mine_compute_*_edges_opt(): the thread t appends the
+ * pairs with MIC >= tau to entry[t] (n[t] edges, size[t] allocated), or
+ * passes them to opt->edge if it is not NULL.
+ */
+typedef struct edge_buffers
+{
+  double tau;
+  int tic;
+  mine_options *opt;
+  edge_entry **entry;
+  long *n;
+  long *size;
+} edge_buffers;
+
+
+/* pair_sink.store() of mine_compute_*_edges_opt() */
+int edge_store(pair_sink *sink, int t, int i, int j, mine_stats *stats)
+{
+  int ret = 0;
+  double tic;
+  edge_entry *entry;
+  edge_buffers *edges = (edge_buffers *) sink->data;
+
+  /* NaN is never an edge */
+  if (!(stats->mic >= edges->tau))
+    return 0;
+
+  tic = edges->tic ? stats->tic_norm : NAN;
+
+  if (edges->opt->edge != NULL)
     {
-      prob.x = &X->data[i*X->m];
+#ifdef _OPENMP
+      #pragma omp critical (mine_edge)
+#endif
+      ret = edges->opt->edge(edges->opt->edge_data, i, j, stats->mic, tic);
 
-      for (j=0; j<Y->n; j++)
-        {
-          prob.y = &Y->data[j*Y->m];
-          score = mine_compute_score(&prob, param);
-          stats->mic[k] = mine_mic(score);
-          stats->tic[k] = mine_tic(score, TRUE);
-          mine_free_score(&score);
-          k++;
-        }
+      return ret != 0;
     }
 
-  return stats;
+  if (edges->n[t] == edges->size[t])
+    {
+      long size = MAX(2 * edges->size[t], 1024);
+
+      entry = (edge_entry *) realloc (edges->entry[t],
+                                      size * sizeof(edge_entry));
+      if (entry == NULL)
+        return 1;
+
+      edges->entry[t] = entry;
+      edges->size[t] = size;
+    }
+
+  entry = &edges->entry[t][edges->n[t]++];
+  entry->i = i;
+  entry->j = j;
+  entry->mic = stats->mic;
+  entry->tic = tic;
+
+  return 0;
+}
+
+
+/* qsort() comparison of edges, by i and then by j */
+int compare_edges(const void *a, const void *b)
+{
+  const edge_entry *x = (const edge_entry *) a, *y = (const edge_entry *) b;
+
+  if (x->i != y->i)
+    return (x->i > y->i) - (x->i < y->i);
+
+  return (x->j > y->j) - (x->j < y->j);
+}
+
+
+/*
+ * Concatenates the edges of the num_threads buffers into a sorted
+ * mine_edges. Returns NULL if an error occurs.
+ */
+mine_edges *collect_edges(edge_buffers *edges, int num_threads)
+{
+  int t;
+  long e, n = 0;
+  size_t len;
+  edge_entry *all;
+  mine_edges *out;
+
+  for (t=0; t<num_threads; t++)
+    n += edges->n[t];
+  len = MAX((size_t) n, 1);
+
+  all = (edge_entry *) malloc (len * sizeof(edge_entry));
+  if (all == NULL)
+    goto error_all;
+
+  for (t=0, e=0; t<num_threads; e+=edges->n[t], t++)
+    if (edges->n[t] > 0)
+      memcpy(&all[e], edges->entry[t], edges->n[t] * sizeof(edge_entry));
+
+  /* the order of the threads is not deterministic */
+  qsort(all, n, sizeof(edge_entry), compare_edges);
+
+  out = (mine_edges *) malloc(sizeof(mine_edges));
+  if (out == NULL)
+    goto error_out;
+
+  out->n = n;
+  out->i = (int *) malloc (len * sizeof(int));
+  out->j = (int *) malloc (len * sizeof(int));
+  out->mic = (double *) malloc (len * sizeof(double));
+  out->tic = NULL;
+  if (edges->tic)
+    out->tic = (double *) malloc (len * sizeof(double));
+  if ((out->i == NULL) || (out->j == NULL) || (out->mic == NULL) ||
+      (edges->tic && (out->tic == NULL)))
+    goto error_arrays;
+
+  for (e=0; e<n; e++)
+    {
+      out->i[e] = all[e].i;
+      out->j[e] = all[e].j;
+      out->mic[e] = all[e].mic;
+      if (out->tic != NULL)
+        out->tic[e] = all[e].tic;
+    }
+
+  free(all);
+
+  return out;
+
+  error_arrays:
+    mine_free_edges(&out);
+  error_out:
+    free(all);
+  error_all:
+    return NULL;
+}
+
+
+/*
+ * Computes the edge list of X (Y == NULL, see mine_compute_pstats_edges())
+ * or of X and Y (see mine_compute_cstats_edges()). Returns NULL if an error
+ * occurs.
+ */
+mine_edges *compute_edges(mine_matrix *X, mine_matrix *Y,
+                          mine_parameter *param, double tau,
+                          mine_options *opt)
+{
+  int t, num_threads, error;
+  mine_edges *out = NULL;
+  mine_options opt_edges;
+  edge_buffers edges;
+  pair_sink sink;
+
+  num_threads = get_num_threads(opt);
+
+  edges.tau = tau;
+  edges.tic = (opt->stats & STAT_TIC) != 0;
+  edges.opt = opt;
+  edges.entry = (edge_entry **) calloc (num_threads, sizeof(edge_entry *));
+  edges.n = (long *) calloc (num_threads, sizeof(long));
+  edges.size = (long *) calloc (num_threads, sizeof(long));
+  if ((edges.entry == NULL) || (edges.n == NULL) || (edges.size == NULL))
+    goto error_buffers;
+
+  sink.store = edge_store;
+  sink.data = &edges;
+
+  /* only MIC (and TIC) are needed, the MIC is exact */
+  opt_edges = *opt;
+  opt_edges.stats = STAT_MIC | (opt->stats & STAT_TIC);
+  opt_edges.screen_tau = 0.0;
+
+  if (Y == NULL)
+    error = compute_pstats(X, param, &opt_edges, NULL, NULL,
+                           ((long) X->n * (long) (X->n-1)) / 2, NULL, &sink);
+  else
+    error = compute_cstats(X, Y, param, &opt_edges, NULL, &sink);
+
+  if (!error)
+    out = collect_edges(&edges, num_threads);
+
+  for (t=0; t<num_threads; t++)
+    free(edges.entry[t]);
+
+  error_buffers:
+    free(edges.size);
+    free(edges.n);
+    free(edges.entry);
+
+  return out;
+}
+
+
+/* See mine.h */
+mine_edges *mine_compute_pstats_edges(mine_matrix *X, mine_parameter *param,
+                                      double tau)
+{
+  mine_options opt;
+
+  mine_init_options(&opt);
+
+  return mine_compute_pstats_edges_opt(X, param, tau, &opt);
+}
+
+
+/* See mine.h */
+mine_edges *mine_compute_pstats_edges_opt(mine_matrix *X,
+                                          mine_parameter *param, double tau,
+                                          mine_options *opt)
+{
+  return compute_edges(X, NULL, param, tau, opt);
+}
+
+
+/* See mine.h */
+mine_edges *mine_compute_cstats_edges(mine_matrix *X, mine_matrix *Y,
+                                      mine_parameter *param, double tau)
+{
+  mine_options opt;
+
+  mine_init_options(&opt);
+
+  return mine_compute_cstats_edges_opt(X, Y, param, tau, &opt);
+}
+
+
+/* See mine.h */
+mine_edges *mine_compute_cstats_edges_opt(mine_matrix *X, mine_matrix *Y,
+                                          mine_parameter *param, double tau,
+                                          mine_options *opt)
+{
+  if (X->m != Y->m)
+    return NULL;
+
+  return compute_edges(X, Y, param, tau, opt);
+}
+
+
+/* See mine.h */
+void mine_free_edges(mine_edges **edges)
+{
+  mine_edges *edges_ptr = *edges;
+
+  if (edges_ptr != NULL)
+    {
+      free(edges_ptr->i);
+      free(edges_ptr->j);
+      free(edges_ptr->mic);
+      free(edges_ptr->tic);
+      free(edges_ptr);
+      *edges = NULL;
+    }
+}
+
+
+/* See mine.h */
+void mine_free_cstats(mine_cstats **stats)
+{
+  double **out[STAT_NUM];
+  mine_cstats *stats_ptr = *stats;
+
+  if (stats_ptr != NULL)
+    {
+      stats_arrays(out, &stats_ptr->mic, &stats_ptr->mas, &stats_ptr->mev,
+                   &stats_ptr->mcn, &stats_ptr->mcn_general, &stats_ptr->tic,
+                   &stats_ptr->gmic);
+      free_stats_arrays(out);
+      free(stats_ptr);
+      *stats = NULL;
+    }
 }
@@ -1,10 +1,23 @@
 #ifndef _LIBMINE_H
 #define _LIBMINE_H
 
+#include <stddef.h>
+
 #define LIBMINE_VERSION "1.2.6"
 
-#define EST_MIC_APPROX 0 /* The original MIC estimator */
-#define EST_MIC_E      1 /* MIC_e (TIC_e) estimator */
+#define EST_MIC_APPROX  0 /* The original MIC estimator */
+#define EST_MIC_E       1 /* MIC_e (TIC_e) estimator */
+#define EST_MIC_E_CLUMP 2 /* MIC_e (TIC_e) estimator, faster engine */
+
+/* statistics computed by the convenience functions (mine_options.stats) */
+#define STAT_MIC         (1 << 0)
+#define STAT_MAS         (1 << 1)
+#define STAT_MEV         (1 << 2)
+#define STAT_MCN         (1 << 3)
+#define STAT_MCN_GENERAL (1 << 4)
+#define STAT_TIC         (1 << 5) /* normalized TIC */
+#define STAT_GMIC        (1 << 6)
+#define STAT_ALL         ((1 << 7) - 1)
 
 #define FALSE 0
 #define TRUE 1
@@ -38,10 +51,16 @@ typedef struct mine_problem
  * partition, c=15 meaning that when trying to draw x grid lines on the x-axis,
  * the algorithm will start with at most 15*x clumps. c must be > 0.
  *
- * Est is the estimator, EST_MIC_APPROX and EST_MIC_E. With est=EST_MIC_APPROX,
- * the mine_*() functions return the original statistics, with est=EST_MIC_E the
- * equicharacteristic matrix is computed and mine_mic() and mine_tic() will
- * return MIC_e and TIC_e respectively.
+ * Est is the estimator, EST_MIC_APPROX, EST_MIC_E and EST_MIC_E_CLUMP. With
+ * est=EST_MIC_APPROX, the mine_*() functions return the original statistics,
+ * with est=EST_MIC_E the equicharacteristic matrix is computed and mine_mic()
+ * and mine_tic() will return MIC_e and TIC_e respectively. EST_MIC_E_CLUMP
+ * computes the same equicharacteristic matrix as EST_MIC_E (equal up to
+ * rounding) with an optimization dedicated to its few columns: the HP2Q
+ * matrix is never stored, its columns share their sums with the partitions
+ * into 2 columns and the grids of x vs. y replaced by y vs. x are not
+ * computed. It is about 1.6 times faster and takes O(c*B) memory per
+ * grid row instead of O(c^2 * B^2).
  */
 typedef struct mine_parameter
 {
@@ -55,7 +74,10 @@ typedef struct mine_parameter
  * scores (i.e. the characteristic matrix if est=EST_MIC_APPROX, the
  * equicharacteristic matrix instead). M[i][j] contains the score using a grid
  * partitioning x-values into i+2 bins and y-values into j+2 bins. m and M are
- * of length n and each M[i] is of length m[i].
+ * of length n and each M[i] is of length m[i]. The rows are stored one after
+ * the other (ragged) starting at M[0], M[i+1] = M[i] + m[i]. The structure,
+ * m, M and the rows are allocated in a single block (see
+ * mine_score_size()).
  */
 typedef struct mine_score
 {
@@ -64,6 +86,108 @@ typedef struct mine_score
   double **M; /* the (equi)characteristic matrix */
 } mine_score;
 
+/*
+ * The mine_options structure describes how the computation is carried out.
+ * Always initialize it with mine_init_options() before setting the fields,
+ * so that new fields get their default values.
+ *
+ * num_threads is the number of threads among which the convenience functions
+ * spread the pairs of variables. If num_threads <= 0 one thread per available
+ * core is used. The pairs are scheduled dynamically, therefore pairs with
+ * very different costs do not leave threads idle. mine_compute_score_opt()
+ * spreads instead the rows of the characteristic matrix of its single pair,
+ * with the same results as a single thread; each thread allocates its own
+ * workspace. With more than one thread, mine_compute_score_opt() and
+ * mine_compute_score_ws() also sort large variables in parallel.
+ * num_threads is ignored if libmine is compiled without OpenMP support.
+ * Default: 1.
+ *
+ * max_hp2q_memory is the maximum size in bytes of the HP2Q matrix (about
+ * p^2/2 doubles, where p is the number of clumps) computed for each grid row.
+ * Above this limit the matrix is not stored: the table of optimal partitions
+ * (p+1 doubles for each number of columns) is built in blocks of as many
+ * columns as fit in max_hp2q_memory bytes (at least two), and the HP2Q
+ * matrix is computed one column at a time, once for each block. The results
+ * are the same; the extra cost is about 8*c*B/max_hp2q_memory times the
+ * cost of the table (e.g. 3% for n = 10^7, alpha = 0.6 and c = 15). The
+ * peak memory of each thread is then about 2*max_hp2q_memory bytes plus
+ * O(n + B^2) for the variables (see mine_prepared), e.g. 1.1 GB for
+ * n = 10^7, alpha = 0.6. EST_MIC_E_CLUMP never stores the HP2Q matrix and
+ * ignores max_hp2q_memory. Default: 64 MB.
+ *
+ * min_parallel_clumps is the minimum number of clumps of a grid row for which
+ * the optimization of the row itself is spread among num_threads threads
+ * (the HP2Q matrix and each column of the table of optimal partitions). It
+ * applies when the row is not already computed inside a parallel loop, i.e.
+ * in mine_compute_score_opt() and mine_compute_score_ws(). Default: 10000.
+ *
+ * interrupt, if not NULL, is called as interrupt(interrupt_data) by the
+ * caller's thread between two pairs of variables in mine_compute_pstats_opt(),
+ * mine_compute_cstats_opt(), mine_compute_pairs_opt(),
+ * mine_compute_one_vs_many_opt(), mine_compute_topk_opt() and
+ * mine_compute_*_edges_opt(), between the preparation of two variables
+ * (before the pairs) and between two variables of the final merge of
+ * mine_compute_topk_opt(). If it returns a nonzero value the computation is
+ * stopped and the function returns NULL. Default: NULL.
+ *
+ * stats is the set of statistics (a combination of STAT_* flags) computed by
+ * mine_compute_pstats_opt(), mine_compute_cstats_opt() and
+ * mine_compute_pairs_opt(). The arrays of the statistics not in stats are
+ * NULL. If stats is STAT_MIC, the grid rows whose upper bound cannot exceed
+ * the best score found so far are skipped (set to 0) also by
+ * mine_compute_score_opt() and mine_compute_score_ws(): the MIC is
+ * unchanged, while the other statistics of the score are not meaningful.
+ * Likewise, if stats is STAT_MEV only the scores of the grids with 2 rows or
+ * 2 columns are computed (the others are set to 0), without the expensive
+ * optimization of the grid rows with more than 2 rows. mcn_eps
+ * is the eps of MCN and gmic_p the p of GMIC. Default: STAT_MIC | STAT_TIC,
+ * 0 and -1.
+ *
+ * screen_tau, if > 0 and stats is STAT_MIC, is a screening threshold: the
+ * computation of each pair stops as soon as a score >= screen_tau is found
+ * or the upper bounds of the remaining grid rows are below screen_tau. The
+ * MIC of the pair (mine_mic() or the mic array of the convenience
+ * functions) is then a lower bound of the true MIC if it is >= screen_tau,
+ * an upper bound otherwise, so that it is >= screen_tau if and only if the
+ * true MIC is. Default: 0 (no screening).
+ *
+ * cascade_alpha, if > 0, makes mine_compute_pstats_opt() work in two
+ * stages. First the normalized TIC_e (EST_MIC_E_CLUMP) of every pair is
+ * computed with alpha = cascade_alpha (a cheap B, see mine_parameter) into
+ * the tic_e array of mine_pstats. Then the statistics in stats are computed
+ * with the parameters of the call only for the pairs whose TIC_e is >=
+ * cascade_tau and >= the cascade_quantile quantile of the TIC_e values
+ * (if cascade_quantile > 0); they are NaN for the other pairs. Default: 0,
+ * 0 and 0 (no cascade).
+ *
+ * edge, if not NULL, is called as edge(edge_data, i, j, mic, tic) for each
+ * edge found by mine_compute_pstats_edges_opt() and
+ * mine_compute_cstats_edges_opt(), instead of storing it. It is called by
+ * one thread at a time, in no particular order; tic is NaN if stats does not
+ * contain STAT_TIC. If it returns a nonzero value the computation is stopped
+ * and the function returns NULL. Default: NULL.
+ */
+typedef struct mine_options
+{
+  int num_threads;
+  size_t max_hp2q_memory;
+  int min_parallel_clumps;
+  int (*interrupt)(void *data);
+  void *interrupt_data;
+  int stats;
+  double mcn_eps;
+  double gmic_p;
+  double screen_tau;
+  double cascade_alpha;
+  double cascade_tau;
+  double cascade_quantile;
+  int (*edge)(void *data, int i, int j, double mic, double tic);
+  void *edge_data;
+} mine_options;
+
+/* Sets the default values of the mine_options structure. */
+void mine_init_options(mine_options *opt);
+
 /*
  * Computes the (equi)characteristic matrix (i.e. maximum normalized mutual
  * information scores and returns a mine_score structure. Returns NULL if an
@@ -71,6 +195,112 @@ typedef struct mine_score
  */
 mine_score *mine_compute_score(mine_problem *prob, mine_parameter *param);
 
+/* As mine_compute_score(), using the options opt. */
+mine_score *mine_compute_score_opt(mine_problem *prob, mine_parameter *param,
+                                   mine_options *opt);
+
+/*
+ * The mine_prepared structure contains the data of a single variable which
+ * does not depend on the other variable of the pair: the sort order and the
+ * equipartitions of the variable into i+2 rows (see Algorithm 3 in SOM) for
+ * each row i of the score. A variable prepared once can be paired with any
+ * number of variables of the same length, provided that the same alpha is
+ * used. Each equipartition is stored as the positions (in the sorted
+ * variable) where its rows start. A prepared variable takes O(n + nq^2)
+ * memory: the equipartition into i+2 rows has i+3 positions and nq is about
+ * B/2 (see mine_parameter).
+ */
+typedef struct mine_prepared
+{
+  int n;          /* number of samples */
+  int *idx;       /* indices which sort the variable in increasing order */
+  double *sorted; /* the variable sorted in increasing order */
+  int nq;         /* number of equipartitions (rows of the score) */
+  int *q;         /* q[i] is the number of rows of the i-th equipartition */
+  int **Q;        /* the row r of the i-th equipartition contains the points
+                     sorted[Q[i][r]], ..., sorted[Q[i][r+1]-1] */
+} mine_prepared;
+
+/*
+ * Prepares the variable x of length n. Returns NULL if an error occurs.
+ */
+mine_prepared *mine_prepare(double *x, int n, mine_parameter *param);
+
+/*
+ * As mine_compute_score(), using the prepared variables x and y. x and y must
+ * be of the same length and prepared with the same alpha of param. Returns
+ * NULL if an error occurs.
+ */
+mine_score *mine_compute_score_prepared(mine_prepared *x, mine_prepared *y,
+                                        mine_parameter *param);
+
+/*
+ * This function frees the memory used by a mine_prepared and destroys the
+ * structure.
+ */
+void mine_free_prepared(mine_prepared **prep);
+
+/*
+ * The mine_plan structure contains everything that depends only on the
+ * number of samples n, the parameters and the options: the shape of the
+ * characteristic matrix, the k*log(k) table and the size of a workspace.
+ * A plan can be shared among threads.
+ */
+typedef struct mine_plan
+{
+  int n;                 /* number of samples */
+  mine_parameter param;  /* the parameters */
+  mine_options opt;      /* the options */
+  int score_n;           /* number of rows of the characteristic matrix */
+  int *score_m;          /* number of cols for each row */
+  double *xlogx;         /* xlogx[k] = k*log(k), k = 0, ..., n */
+  size_t workspace_size; /* size in bytes of the arena of a workspace */
+} mine_plan;
+
+/*
+ * The mine_workspace structure holds all the buffers needed to compute the
+ * score of a pair of variables of a plan, allocated in a single block. A
+ * workspace must not be shared among threads.
+ */
+typedef struct mine_workspace mine_workspace;
+
+/*
+ * Creates a plan for variables of length n. If opt is NULL the default
+ * options are used. Returns NULL if an error occurs.
+ */
+mine_plan *mine_create_plan(int n, mine_parameter *param, mine_options *opt);
+
+/*
+ * This function frees the memory used by a mine_plan and destroys the
+ * structure.
+ */
+void mine_free_plan(mine_plan **plan);
+
+/*
+ * Allocates a workspace for the plan. Returns NULL if an error occurs.
+ */
+mine_workspace *mine_create_workspace(mine_plan *plan);
+
+/*
+ * This function frees the memory used by a mine_workspace and destroys the
+ * structure.
+ */
+void mine_free_workspace(mine_workspace **ws);
+
+/*
+ * Allocates a score with the shape of the plan. Returns NULL if an error
+ * occurs.
+ */
+mine_score *mine_alloc_score(mine_plan *plan);
+
+/*
+ * As mine_compute_score(), using the workspace ws. The score must be
+ * allocated by mine_alloc_score() with the plan of ws and is overwritten.
+ * No memory is allocated. Returns 0 on success, 1 if an error occurs.
+ */
+int mine_compute_score_ws(mine_problem *prob, mine_workspace *ws,
+                          mine_score *score);
+
 /*
  * Checks the parameters. This function should be called before calling
  * mine_compute_score(). It returns NULL if the parameters are feasible,
@@ -100,15 +330,60 @@ double mine_mcn_general(mine_score *score);
  */
 double mine_tic(mine_score *score, int norm);
 
-/* Returns the Generalized Mean Information Coefficient (GMIC). */
+/*
+ * Returns the Generalized Mean Information Coefficient (GMIC). Returns NaN if
+ * an error occurs.
+ */
 double mine_gmic(mine_score *score, double p);
 
+/*
+ * The mine_stats structure contains all the statistics of a score, see
+ * mine_all_stats().
+ */
+typedef struct mine_stats
+{
+  double mic;
+  double mas;
+  double mev;
+  double mcn;         /* MCN with the eps of mine_all_stats() */
+  double mcn_general;
+  double tic;         /* TIC, not normalized */
+  double tic_norm;    /* TIC normalized in [0, 1] */
+  double gmic;        /* GMIC with the p of mine_all_stats() */
+} mine_stats;
+
+/*
+ * Computes all the statistics of score at once, with the same results of
+ * mine_mic(), mine_mas(), mine_mev(), mine_mcn(score, eps),
+ * mine_mcn_general(), mine_tic() and mine_gmic(score, p).
+ */
+void mine_all_stats(mine_score *score, double eps, double p,
+                    mine_stats *stats);
+
 /*
  * This function frees the memory used by a mine_score and destroys the score
  * structure.
  */
 void mine_free_score(mine_score **score);
 
+/*
+ * Returns the size in bytes of the single block which holds the score (the
+ * structure, m, M and the matrix). The block starts at the address score.
+ */
+size_t mine_score_size(mine_score *score);
+
+/*
+ * Sets the pointers m and M of a score block copied or loaded to the address
+ * block (e.g. with memcpy() or fread() of mine_score_size() bytes) and
+ * returns the score. The block must come from the same platform.
+ */
+mine_score *mine_relocate_score(void *block);
+
+/*
+ * Returns a copy of score. Returns NULL if an error occurs.
+ */
+mine_score *mine_copy_score(mine_score *score);
+
 
 /* CONVENIENCE STRUCTURES AND FUNCTIONS */
 
@@ -124,13 +399,20 @@ typedef struct mine_matrix
  * For each statistic, the upper triangle of the matrix is stored by row
  * (condensed matrix). If m is the number of variables, then for i < j < m, the
  * statistic between (row) i and j is stored in k = m*i - i*(i+1)/2 - i - 1 + j.
- * The length of the vectors is n = m*(m-1)/2.
+ * The length of the vectors is n = m*(m-1)/2. tic_e is the first stage of
+ * the cascade (see mine_options.cascade_alpha), NULL without cascade.
  */
 typedef struct mine_pstats
 {
-  double *mic; /* condensed matrix */
-  double *tic; /* condensed matrix */
-  int n;       /* number of elements */
+  double *mic;         /* condensed matrix */
+  double *tic;         /* condensed matrix (normalized TIC) */
+  long n;              /* number of elements */
+  double *mas;         /* condensed matrix */
+  double *mev;         /* condensed matrix */
+  double *mcn;         /* condensed matrix */
+  double *mcn_general; /* condensed matrix */
+  double *gmic;        /* condensed matrix */
+  double *tic_e;       /* condensed matrix (normalized TIC_e, cascade) */
 } mine_pstats;
 
 
@@ -142,24 +424,171 @@ typedef struct mine_pstats
  */
 typedef struct mine_cstats
 {
-  double *mic; /* matrix in row-major order */
-  double *tic; /* matrix in row-major order */
-  int n;       /* number of rows */
-  int m;       /* number of cols */
+  double *mic;         /* matrix in row-major order */
+  double *tic;         /* matrix in row-major order (normalized TIC) */
+  int n;               /* number of rows */
+  int m;               /* number of cols */
+  double *mas;         /* matrix in row-major order */
+  double *mev;         /* matrix in row-major order */
+  double *mcn;         /* matrix in row-major order */
+  double *mcn_general; /* matrix in row-major order */
+  double *gmic;        /* matrix in row-major order */
 } mine_cstats;
 
+/*
+ * The k neighbors of each of the n variables with the highest MIC, from the
+ * highest (ties by increasing index). The neighbor r of the variable i is
+ * index[i*k + r], with statistics mic[i*k + r] and tic[i*k + r].
+ */
+typedef struct mine_topk
+{
+  int *index;  /* matrix in row-major order (n x k) */
+  double *mic; /* matrix in row-major order (n x k) */
+  double *tic; /* matrix in row-major order (normalized TIC), or NULL */
+  int n;       /* number of variables */
+  int k;       /* number of neighbors per variable */
+} mine_topk;
+
+/*
+ * Edge list (sparse matrix in coordinate format) of the pairs of variables
+ * (i[e], j[e]) with MIC >= tau, sorted by i and then by j, with statistics
+ * mic[e] and tic[e], 0 <= e < n.
+ */
+typedef struct mine_edges
+{
+  int *i;      /* first variable (row of X) */
+  int *j;      /* second variable (row of X or Y) */
+  double *mic; /* MIC */
+  double *tic; /* normalized TIC, or NULL */
+  long n;      /* number of edges */
+} mine_edges;
+
 /*
  * Compute pairwise statistics (MIC and normalized TIC) between variables.
+ * Returns NULL if an error occurs. The arrays and the structure must be freed
+ * with mine_free_pstats().
  */
 mine_pstats *mine_compute_pstats(mine_matrix *X, mine_parameter *param);
 
+/* As mine_compute_pstats(), using the options opt. */
+mine_pstats *mine_compute_pstats_opt(mine_matrix *X, mine_parameter *param,
+                                     mine_options *opt);
+
 /*
  * Compute statistics (MIC and normalized TIC) between each pair of the two
- * collections of variables.
+ * collections of variables. Returns NULL if an error occurs. The arrays and
+ * the structure must be freed with mine_free_cstats().
  */
 mine_cstats *mine_compute_cstats(mine_matrix *X, mine_matrix *Y,
                                  mine_parameter *param);
 
+/* As mine_compute_cstats(), using the options opt. */
+mine_cstats *mine_compute_cstats_opt(mine_matrix *X, mine_matrix *Y,
+                                     mine_parameter *param, mine_options *opt);
+
+/* Frees the arrays of a mine_pstats and destroys the structure. */
+void mine_free_pstats(mine_pstats **stats);
+
+/*
+ * Compute statistics (MIC and normalized TIC) between the npairs pairs of
+ * variables (rows) of X listed in pairs: the pair k is (pairs[2*k],
+ * pairs[2*k+1]) and its statistics are stored at the index k of the arrays
+ * of the returned mine_pstats (n = npairs). Only the variables in pairs are
+ * sorted and equipartitioned, once each, and the pairs are spread among
+ * threads as in mine_compute_pstats_opt(). Returns NULL if an error occurs
+ * (e.g. an index out of range). The result must be freed with
+ * mine_free_pstats().
+ */
+mine_pstats *mine_compute_pairs(mine_matrix *X, int *pairs, long npairs,
+                                mine_parameter *param);
+
+/* As mine_compute_pairs(), using the options opt (except cascade_*). */
+mine_pstats *mine_compute_pairs_opt(mine_matrix *X, int *pairs, long npairs,
+                                    mine_parameter *param, mine_options *opt);
+
+/*
+ * Compute statistics (MIC and normalized TIC) between each variable (row) of
+ * X and the variable target (of length X->m), as mine_compute_cstats() with
+ * the single row target as Y: the statistic of the row i is stored in i
+ * (n = X->n, m = 1). The target is sorted and equipartitioned once, each
+ * row of X right before its use in the workspace of its thread, so the
+ * rows of X are never stored prepared. Returns NULL if an error occurs. The
+ * result must be freed with mine_free_cstats().
+ */
+mine_cstats *mine_compute_one_vs_many(double *target, mine_matrix *X,
+                                      mine_parameter *param);
+
+/* As mine_compute_one_vs_many(), using the options opt. */
+mine_cstats *mine_compute_one_vs_many_opt(double *target, mine_matrix *X,
+                                          mine_parameter *param,
+                                          mine_options *opt);
+
+/*
+ * Compute the k neighbors of each variable (row) of X with the highest MIC,
+ * as mine_compute_pstats() without storing the condensed matrices: each
+ * thread keeps a heap of k neighbors per variable and the heaps are merged
+ * at the end (memory: num_threads * n * k neighbors). As in all the
+ * convenience functions, the variables are prepared once, up front, so the
+ * memory is also O(X->n * (X->m + nq^2)) for nq = B/2 equipartitions (see
+ * mine_prepared), about 1.5 GB for 10^4 variables of 10^4 samples and
+ * alpha = 0.6. If X->n - 1 < k then
+ * k = X->n - 1. Returns NULL if an error occurs (e.g. k < 1). The result
+ * must be freed with mine_free_topk().
+ */
+mine_topk *mine_compute_topk(mine_matrix *X, mine_parameter *param, int k);
+
+/*
+ * As mine_compute_topk(), using the options opt (except screen_tau and
+ * cascade_*). The normalized TIC is computed if opt->stats contains
+ * STAT_TIC, the other statistics are ignored.
+ */
+mine_topk *mine_compute_topk_opt(mine_matrix *X, mine_parameter *param, int k,
+                                 mine_options *opt);
+
+/* Frees the arrays of a mine_topk and destroys the structure. */
+void mine_free_topk(mine_topk **topk);
+
+/*
+ * Compute the edge list of the pairs of variables (rows) i < j of X with
+ * MIC >= tau, as mine_compute_pstats() without storing the condensed
+ * matrices: each thread appends the edges it finds to its own buffer and
+ * the buffers are concatenated at the end, so the memory is proportional to
+ * the number of edges. Returns NULL if an error occurs. The result must be
+ * freed with mine_free_edges().
+ */
+mine_edges *mine_compute_pstats_edges(mine_matrix *X, mine_parameter *param,
+                                      double tau);
+
+/*
+ * As mine_compute_pstats_edges(), using the options opt (except screen_tau
+ * and cascade_*). The normalized TIC is computed if opt->stats contains
+ * STAT_TIC, the other statistics are ignored. If opt->edge is not NULL the
+ * edges are passed to it and the returned edge list is empty.
+ */
+mine_edges *mine_compute_pstats_edges_opt(mine_matrix *X,
+                                          mine_parameter *param, double tau,
+                                          mine_options *opt);
+
+/*
+ * Compute the edge list of the pairs of variables (rows) i of X and j of Y
+ * with MIC >= tau, as mine_compute_cstats() without storing the matrices
+ * (see mine_compute_pstats_edges()). Returns NULL if an error occurs. The
+ * result must be freed with mine_free_edges().
+ */
+mine_edges *mine_compute_cstats_edges(mine_matrix *X, mine_matrix *Y,
+                                      mine_parameter *param, double tau);
+
+/* As mine_compute_cstats_edges(), see mine_compute_pstats_edges_opt(). */
+mine_edges *mine_compute_cstats_edges_opt(mine_matrix *X, mine_matrix *Y,
+                                          mine_parameter *param, double tau,
+                                          mine_options *opt);
+
+/* Frees the arrays of a mine_edges and destroys the structure. */
+void mine_free_edges(mine_edges **edges);
+
+/* Frees the arrays of a mine_cstats and destroys the structure. */
+void mine_free_cstats(mine_cstats **stats);
+
 #ifdef __cplusplus
 }
 #endif
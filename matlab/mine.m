@@ -19,6 +19,8 @@ function [minestats, M] = mine(x, y, alpha, c, est)
 %   estimator. With est="mic_approx" the original MINE statistics will be
 %   computed, with est="mic_e" the equicharacteristic matrix is is evaluated and
 %   the mic() and tic() methods will return MIC_e and TIC_e values respectively.
+%   est="mic_e_clump" computes MIC_e and TIC_e as the EquicharClump algorithm,
+%   faster and with close but not identical values.
 %
 %   MINESTATS = MINE(X, Y, ALPHA, C) computes the MINE statistics
 %   between X and Y. Default value of EST is 'mic_approx'.
@@ -58,6 +60,8 @@ end
 
 if strcmpi(est, 'mic_approx')
     e = 0;
+elseif strcmpi(est, 'mic_e_clump')
+    e = 2;
 else
     e = 1;
 end
@@ -36,6 +36,7 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
   mine_problem problem;
   mine_parameter param;
   mine_score *score;
+  mine_stats stats;
   char *ret;
   double *out;
 
@@ -109,27 +110,28 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
   /* build the output array*/
   plhs[0] = mxCreateDoubleMatrix(1, 6, mxREAL);
   out = mxGetPr(plhs[0]);
-  out[0] = mine_mic(score);
-  out[1] = mine_mas(score);
-  out[2] = mine_mev(score);
-  out[3] = mine_mcn(score, 0);
-  out[4] = mine_mcn_general(score);
-  out[5] = mine_tic(score, 0);
+  mine_all_stats(score, 0, -1, &stats);
+  out[0] = stats.mic;
+  out[1] = stats.mas;
+  out[2] = stats.mev;
+  out[3] = stats.mcn;
+  out[4] = stats.mcn_general;
+  out[5] = stats.tic;
 
   /* return the (equi)characteristic matrix */
   if (nlhs>1)
     {
       mwSize i, j, nrows, ncols;
       nrows = score->n;
-      ncols = score->m[0];
+      ncols = score->m[0]; /* the longest row */
       plhs[1] = mxCreateDoubleMatrix(nrows, ncols, mxREAL);
       out = mxGetPr(plhs[1]);
 
+      /* each row M[i] (m[i] entries) is written with stride nrows into the
+         column-major matrix. The missing entries are 0 */
       for (i=0; i<nrows; i++)
-				{
-    			for (j=0; j<score->m[i]; j++)
-        		out[nrows*j + i] = score->M[i][j];
-        }
+        for (j=0; j<score->m[i]; j++)
+          out[nrows*j + i] = score->M[i][j];
     }
 
   mine_free_score(&score);
@@ -1,4 +1,4 @@
-from .mine import MINE, pstats, cstats
+from .mine import MINE, pstats, cstats, mic_scores, pair_stats
 from .mine import version as __version__
 
-__all__ = ["MINE", "pstats", "cstats"]
+__all__ = ["MINE", "pstats", "cstats", "mic_scores", "pair_stats"]
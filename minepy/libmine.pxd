@@ -16,6 +16,23 @@ cdef extern from "../libmine/mine.h":
 
     char *libmine_version
 
+    ctypedef struct mine_options:
+        int num_threads
+        size_t max_hp2q_memory
+        int min_parallel_clumps
+        int (*interrupt)(void *data) noexcept nogil
+        void *interrupt_data
+        int stats
+        double mcn_eps
+        double gmic_p
+        double screen_tau
+        double cascade_alpha
+        double cascade_tau
+        double cascade_quantile
+        int (*edge)(void *data, int i, int j, double mic, double tic) noexcept nogil
+        void *edge_data
+
+    void mine_init_options(mine_options *opt) nogil
     mine_score *mine_compute_score (mine_problem *prob,
                                     mine_parameter *param) nogil
     char *mine_check_parameter(mine_parameter *param) nogil
@@ -27,8 +44,29 @@ cdef extern from "../libmine/mine.h":
     double mine_tic (mine_score *score, int norm) nogil
     double mine_gmic (mine_score *score, double p) nogil
     void mine_free_score (mine_score **score) nogil
+
+    ctypedef struct mine_stats:
+        double mic
+        double mas
+        double mev
+        double mcn
+        double mcn_general
+        double tic
+        double tic_norm
+        double gmic
+
+    void mine_all_stats (mine_score *score, double eps, double p,
+                         mine_stats *stats) nogil
     int EST_MIC_APPROX
     int EST_MIC_E
+    int EST_MIC_E_CLUMP
+    int STAT_MIC
+    int STAT_MAS
+    int STAT_MEV
+    int STAT_MCN
+    int STAT_MCN_GENERAL
+    int STAT_TIC
+    int STAT_GMIC
 
     # convenience structures and functions
     ctypedef struct mine_matrix:
@@ -39,14 +77,64 @@ cdef extern from "../libmine/mine.h":
     ctypedef struct mine_pstats:
         double *mic
         double *tic
-        int n
+        long n
+        double *mas
+        double *mev
+        double *mcn
+        double *mcn_general
+        double *gmic
+        double *tic_e
 
     ctypedef struct mine_cstats:
         double *mic
         double *tic
         int n
         int m
+        double *mas
+        double *mev
+        double *mcn
+        double *mcn_general
+        double *gmic
+
+    ctypedef struct mine_topk:
+        int *index
+        double *mic
+        double *tic
+        int n
+        int k
+
+    ctypedef struct mine_edges:
+        int *i
+        int *j
+        double *mic
+        double *tic
+        long n
 
     mine_pstats *mine_compute_pstats(mine_matrix *X, mine_parameter *param) nogil
     mine_cstats *mine_compute_cstats(mine_matrix *X, mine_matrix *Y,
-                                     mine_parameter *param) nogil
\ No newline at end of file
+                                     mine_parameter *param) nogil
+    mine_pstats *mine_compute_pstats_opt(mine_matrix *X, mine_parameter *param,
+                                         mine_options *opt) nogil
+    mine_cstats *mine_compute_cstats_opt(mine_matrix *X, mine_matrix *Y,
+                                         mine_parameter *param,
+                                         mine_options *opt) nogil
+    mine_pstats *mine_compute_pairs_opt(mine_matrix *X, int *pairs,
+                                        long npairs, mine_parameter *param,
+                                        mine_options *opt) nogil
+    mine_cstats *mine_compute_one_vs_many_opt(double *target, mine_matrix *X,
+                                              mine_parameter *param,
+                                              mine_options *opt) nogil
+    mine_topk *mine_compute_topk_opt(mine_matrix *X, mine_parameter *param,
+                                     int k, mine_options *opt) nogil
+    void mine_free_topk(mine_topk **topk) nogil
+    mine_edges *mine_compute_pstats_edges_opt(mine_matrix *X,
+                                              mine_parameter *param,
+                                              double tau,
+                                              mine_options *opt) nogil
+    mine_edges *mine_compute_cstats_edges_opt(mine_matrix *X, mine_matrix *Y,
+                                              mine_parameter *param,
+                                              double tau,
+                                              mine_options *opt) nogil
+    void mine_free_edges(mine_edges **edges) nogil
+    void mine_free_pstats(mine_pstats **pstats) nogil
+    void mine_free_cstats(mine_cstats **cstats) nogil
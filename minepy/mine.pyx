@@ -25,9 +25,37 @@ from __future__ import division
 import numpy as np
 cimport numpy as np
 from libc.stdlib cimport *
+from libc.string cimport memcpy
+from cpython.exc cimport PyErr_Occurred
 from .libmine cimport *
 cimport cython
 
+cdef extern from "Python.h":
+    # declared without exception checking: the exception raised by a signal
+    # handler is left pending and re-raised by _raise_pending()
+    int PyErr_CheckSignals()
+
+cdef extern from *:
+    """
+    /* monotonic wall clock in seconds, callable without the GIL */
+    #ifdef _WIN32
+    #include <windows.h>
+    static double minepy_monotonic(void)
+    {
+      return (double) GetTickCount64() / 1000.0;
+    }
+    #else
+    #include <time.h>
+    static double minepy_monotonic(void)
+    {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+    }
+    #endif
+    """
+    double minepy_monotonic() nogil
+
 np.import_array()
 
 version = libmine_version
@@ -35,9 +63,104 @@ version = libmine_version
 
 EST = {
     "mic_approx": EST_MIC_APPROX,
-	"mic_e": EST_MIC_E
+	"mic_e": EST_MIC_E,
+	"mic_e_clump": EST_MIC_E_CLUMP
 	}
 
+STATS = {
+    "mic": STAT_MIC,
+    "mas": STAT_MAS,
+    "mev": STAT_MEV,
+    "mcn": STAT_MCN,
+    "mcn_general": STAT_MCN_GENERAL,
+    "tic": STAT_TIC,
+    "gmic": STAT_GMIC
+    }
+
+cdef int _check_signals(void *data) noexcept nogil:
+    # libmine interrupt callback (see mine_options), called between two pairs
+    # of variables and between two variables of the preparation and of the
+    # top-k merge. Runs the Python signal handlers at most every 0.1 s of
+    # wall time, whatever the number of threads, and returns 1 if one of them
+    # raised an exception (e.g. KeyboardInterrupt).
+    cdef double *last = <double *> data
+    cdef double now = minepy_monotonic()
+
+    if now - last[0] < 0.1:
+        return 0
+    last[0] = now
+
+    with gil:
+        return PyErr_CheckSignals() != 0
+
+
+cdef int _raise_pending() except -1:
+    # propagates the exception left pending by _check_signals()
+    return -1
+
+
+cdef object _owned_array(void *data, int nd, np.npy_intp *shape,
+                         int typenum=np.NPY_DOUBLE):
+    # wraps data (allocated by libmine) in an ndarray which owns it
+    if data is NULL:
+        return None
+
+    arr = np.PyArray_SimpleNewFromData(nd, shape, typenum, data)
+    np.PyArray_UpdateFlags(arr, arr.flags.num | np.NPY_OWNDATA)
+
+    return arr
+
+
+cdef tuple _stats_tuple(stats, int nd, np.npy_intp *shape, double *mic,
+                        double *mas, double *mev, double *mcn,
+                        double *mcn_general, double *tic, double *gmic):
+    # returns the arrays of the statistics in the order of stats
+    arrays = {
+        "mic": _owned_array(mic, nd, shape),
+        "mas": _owned_array(mas, nd, shape),
+        "mev": _owned_array(mev, nd, shape),
+        "mcn": _owned_array(mcn, nd, shape),
+        "mcn_general": _owned_array(mcn_general, nd, shape),
+        "tic": _owned_array(tic, nd, shape),
+        "gmic": _owned_array(gmic, nd, shape)
+        }
+
+    return tuple(arrays[name] for name in stats)
+
+
+cdef tuple _edges_tuple(stats, mine_edges *edges):
+    # returns the arrays of the edge list, the structure is freed
+    cdef np.npy_intp shape[1]
+
+    shape[0] = <np.npy_intp> edges.n
+    result = ((_owned_array(edges.i, 1, shape, np.NPY_INT),
+               _owned_array(edges.j, 1, shape, np.NPY_INT)) +
+              _stats_tuple(stats, 1, shape, edges.mic, NULL, NULL, NULL, NULL,
+                           edges.tic, NULL))
+
+    # the arrays are owned by the ndarrays
+    free(edges)
+
+    return result
+
+
+def _check_sparse_stats(stats, option):
+    # top_k and edge_tau keep only MIC and TIC
+    if not set(stats) <= {"mic", "tic"}:
+        raise ValueError("only 'mic' and 'tic' are available with %s" % option)
+
+
+cdef int _stats_mask(stats) except -1:
+    cdef int mask = 0
+
+    for name in stats:
+        if name not in STATS:
+            raise ValueError("unknown statistic %s" % name)
+        mask |= STATS[name]
+
+    return mask
+
+
 cdef class MINE:
     """Maximal Information-based Nonparametric Exploration.
 
@@ -53,11 +176,12 @@ cdef class MINE:
         every partition. Default value is 15, meaning that when trying to
         draw x grid lines on the x-axis, the algorithm will start with at
         most 15*x clumps.
-    est : str ("mic_approx", "mic_e")
+    est : str ("mic_approx", "mic_e", "mic_e_clump")
         estimator. With est="mic_approx" the original MINE statistics will
         be computed, with est="mic_e" the equicharacteristic matrix is
         is evaluated and the mic() and tic() methods will return MIC_e and
-        TIC_e values respectively.
+        TIC_e values respectively. est="mic_e_clump" computes the same MIC_e
+        and TIC_e (equal up to rounding) about 1.6 times faster.
     """
 
     cdef mine_problem prob
@@ -168,26 +292,62 @@ cdef class MINE:
 
         return mine_tic(self.score, norm)
 
-    @cython.boundscheck(True)
-    def get_score(self):
+    def all_stats(self, eps=0, p=-1):
+        """Returns all the statistics at once, computed in a single pass over
+        the (equi)characteristic matrix: a dict with keys "mic", "mas",
+        "mev", "mcn" (with eps), "mcn_general", "tic", "tic_norm" (TIC
+        normalized in [0, 1]) and "gmic" (with p).
+        """
+
+        cdef mine_stats stats
+
+        if self.score is NULL:
+            raise ValueError("no score computed")
+
+        mine_all_stats(self.score, eps, p, &stats)
+
+        return stats
+
+    def get_score(self, ragged=False):
         """Returns the maximum normalized mutual information scores (i.e. the
         characteristic matrix M if est="mic_approx", the equicharacteristic
-        matrix instead). M is a list of 1d numpy arrays where M[i][j] contains
-        the score using a grid partitioning x-values into i+2 bins and y-values
-        into j+2 bins.
+        matrix instead). M is a 2D numpy array where M[i, j] contains the
+        score using a grid partitioning x-values into i+2 bins and y-values
+        into j+2 bins. The rows have different lengths (i+2)*(j+2) <= B, the
+        missing entries are NaN. The rows are copied one at a time.
+
+        If ragged is True, returns instead the tuple (scores, m), where m is
+        the 1D array of the lengths of the rows of M and scores is the 1D
+        array of the rows stored one after the other (the row i starts at
+        m[:i].sum()), copied from the score with a single memcpy.
         """
 
-        cdef int i, j
+        cdef int i
+        cdef size_t length = 0
+        cdef np.ndarray[np.float_t, ndim=2] M
+        cdef np.ndarray scores, m
 
         if self.score is NULL:
             raise ValueError("no score computed")
 
-        M = []
+        if ragged:
+            # the rows are stored one after the other from M[0], see mine.h
+            m = np.empty(self.score.n, dtype=np.intc)
+            memcpy(np.PyArray_DATA(m), <void *> self.score.m,
+                   self.score.n * sizeof(int))
+            for i in range(self.score.n):
+                length += self.score.m[i]
+            scores = np.empty(length, dtype=np.float64)
+            memcpy(np.PyArray_DATA(scores), <void *> self.score.M[0],
+                   length * sizeof(double))
+            return scores, m
+
+        # the rows of the score (m[0] is the longest) are copied one at a
+        # time into the NaN-padded matrix
+        M = np.full((self.score.n, self.score.m[0]), np.nan, dtype=np.float64)
         for i in range(self.score.n):
-            M_temp = np.empty(self.score.m[i], dtype=np.float64)
-            for j in range(self.score.m[i]):
-                M_temp[j] = self.score.M[i][j]
-            M.append(M_temp)
+            memcpy(<void *> &M[i, 0], <void *> self.score.M[i],
+                   self.score.m[i] * sizeof(double))
 
         return M
 
@@ -202,7 +362,9 @@ cdef class MINE:
 
 
 @cython.boundscheck(False)
-def pstats(X, alpha=0.6, c=15, est="mic_approx"):
+def pstats(X, alpha=0.6, c=15, est="mic_approx", n_jobs=1,
+           stats=("mic", "tic"), eps=0, p=-1, tau=0, cascade_alpha=0,
+           cascade_tau=0, cascade_quantile=0, top_k=0, edge_tau=None):
     """Compute pairwise statistics (MIC and normalized TIC) between variables
     (convenience function).
 
@@ -225,10 +387,50 @@ def pstats(X, alpha=0.6, c=15, est="mic_approx"):
         every partition. Default value is 15, meaning that when trying to
         draw x grid lines on the x-axis, the algorithm will start with at
         most 15*x clumps.
-    est : str ("mic_approx", "mic_e")
+    est : str ("mic_approx", "mic_e", "mic_e_clump")
         estimator. With est="mic_approx" the original MINE statistics will
         be computed, with est="mic_e" the equicharacteristic matrix is
-        is evaluated and MIC_e and TIC_e are returned.
+        is evaluated and MIC_e and TIC_e are returned. est="mic_e_clump"
+        computes the same MIC_e and TIC_e faster (see MINE).
+    n_jobs : int
+        number of threads among which the pairs of variables are spread. If
+        n_jobs <= 0 one thread per available core is used. Ignored if minepy
+        is compiled without OpenMP support. The GIL is released during the
+        computation, which can be interrupted (e.g. with Ctrl-C).
+    stats : sequence of str
+        the statistics to compute, among "mic", "mas", "mev", "mcn",
+        "mcn_general", "tic" (normalized) and "gmic". Only the requested
+        statistics are computed and returned, in the same order.
+    eps : float (>= 0)
+        eps of MCN.
+    p : float
+        p of GMIC.
+    tau : float (>= 0)
+        screening threshold, used if stats is ("mic",). If tau > 0 the
+        computation of each pair stops as soon as MIC >= tau is found or
+        MIC < tau is proven. The returned values are then bounds of the MIC
+        (lower bounds if >= tau, upper bounds otherwise), so that mic >= tau
+        is the screening result.
+    cascade_alpha : float
+        if > 0, two-stage computation. First the normalized TIC_e
+        (est="mic_e_clump") of every pair is computed with alpha=cascade_alpha
+        (a cheap B), then the statistics in stats are computed only for the
+        pairs whose TIC_e is >= cascade_tau and >= the cascade_quantile
+        quantile of the TIC_e values (if cascade_quantile > 0). The
+        statistics of the other pairs are NaN and the TIC_e array is
+        appended to the returned tuple.
+    cascade_tau : float
+        threshold of the cascade (see cascade_alpha).
+    cascade_quantile : float in [0, 1]
+        quantile threshold of the cascade (see cascade_alpha).
+    top_k : int (>= 0)
+        if > 0, only the top_k neighbors of each variable with the highest
+        MIC are returned, without storing the condensed matrices. stats may
+        contain only "mic" and "tic"; tau and the cascade are ignored.
+    edge_tau : float or None
+        if not None, only the pairs with MIC >= edge_tau are returned, as an
+        edge list, without storing the condensed matrices. stats may contain
+        only "mic" and "tic"; tau and the cascade are ignored.
 
     Returns
     -------
@@ -236,15 +438,30 @@ def pstats(X, alpha=0.6, c=15, est="mic_approx"):
         the condensed MIC statistic matrix of length n*(n-1)/2.
     tic : 1D ndarray
         the condensed normalized TIC statistic matrix of length n*(n-1)/2.
+
+    With a different stats, one condensed matrix for each statistic in stats,
+    followed by the TIC_e condensed matrix if cascade_alpha > 0.
+
+    If top_k > 0, the n x k (k = min(top_k, n-1)) array of the indices of
+    the neighbors of each variable, from the highest MIC (ties by increasing
+    index), followed by one n x k array for each statistic in stats.
+
+    If edge_tau is not None, the arrays i and j (i < j) of the edges, sorted
+    by i and then by j, followed by one array for each statistic in stats.
     """
 
     cdef int n, d
     cdef mine_parameter param
     cdef mine_matrix Xm
     cdef mine_pstats *pstats
+    cdef mine_topk *topk
+    cdef mine_edges *edges
+    cdef int k = <int> top_k
+    cdef double edge_t = -1
+    cdef mine_options opt
+    cdef double last_check
     cdef np.ndarray[np.float_t, ndim=2] Xa
-    cdef np.ndarray[np.float_t, ndim=1] mica, tica
-    cdef np.npy_intp shape[1]
+    cdef np.npy_intp shape[2]
 
 
     param.c = <double> c
@@ -255,29 +472,91 @@ def pstats(X, alpha=0.6, c=15, est="mic_approx"):
     if ret:
         raise ValueError(ret)
 
+    if k < 0:
+        raise ValueError("top_k must be >= 0")
+
+    if k > 0:
+        _check_sparse_stats(stats, "top_k")
+
+    if edge_tau is not None:
+        if k > 0:
+            raise ValueError("top_k and edge_tau are mutually exclusive")
+        _check_sparse_stats(stats, "edge_tau")
+        edge_t = <double> edge_tau
+
     Xa = np.ascontiguousarray(X, dtype=np.float64)
     Xm.data = <double *> Xa.data
     Xm.n = <int> Xa.shape[0]
     Xm.m = <int> Xa.shape[1]
 
-    pstats = mine_compute_pstats(&Xm, &param)
+    mine_init_options(&opt)
+    opt.num_threads = <int> n_jobs
+    opt.stats = _stats_mask(stats)
+    opt.mcn_eps = <double> eps
+    opt.gmic_p = <double> p
+    opt.screen_tau = <double> tau
+    opt.cascade_alpha = <double> cascade_alpha
+    opt.cascade_tau = <double> cascade_tau
+    opt.cascade_quantile = <double> cascade_quantile
+    opt.interrupt = _check_signals
+    last_check = minepy_monotonic()
+    opt.interrupt_data = <void *> &last_check
+
+    if k > 0:
+        with nogil:
+            topk = mine_compute_topk_opt(&Xm, &param, k, &opt)
 
-    shape[0] = <np.npy_intp> pstats.n
-    mica = np.PyArray_SimpleNewFromData(1, shape, np.NPY_DOUBLE,
-                                        <void *> pstats.mic)
-    np.PyArray_UpdateFlags(mica, mica.flags.num | np.NPY_OWNDATA)
+        if topk is NULL:
+            if PyErr_Occurred() is not NULL:
+                _raise_pending()
+            raise ValueError("problem with mine_compute_topk()")
+
+        shape[0] = <np.npy_intp> topk.n
+        shape[1] = <np.npy_intp> topk.k
+        result = ((_owned_array(topk.index, 2, shape, np.NPY_INT), ) +
+                  _stats_tuple(stats, 2, shape, topk.mic, NULL, NULL, NULL,
+                               NULL, topk.tic, NULL))
+
+        # the arrays are owned by the ndarrays
+        free(topk)
 
-    tica = np.PyArray_SimpleNewFromData(1, shape, np.NPY_DOUBLE,
-                                        <void *> pstats.tic)
-    np.PyArray_UpdateFlags(tica, tica.flags.num | np.NPY_OWNDATA)
+        return result
 
+    if edge_tau is not None:
+        with nogil:
+            edges = mine_compute_pstats_edges_opt(&Xm, &param, edge_t, &opt)
+
+        if edges is NULL:
+            if PyErr_Occurred() is not NULL:
+                _raise_pending()
+            raise ValueError("problem with mine_compute_pstats_edges()")
+
+        return _edges_tuple(stats, edges)
+
+    with nogil:
+        pstats = mine_compute_pstats_opt(&Xm, &param, &opt)
+
+    if pstats is NULL:
+        if PyErr_Occurred() is not NULL:
+            _raise_pending()
+        raise ValueError("problem with mine_compute_pstats()")
+
+    shape[0] = <np.npy_intp> pstats.n
+    result = _stats_tuple(stats, 1, shape, pstats.mic, pstats.mas,
+                          pstats.mev, pstats.mcn, pstats.mcn_general,
+                          pstats.tic, pstats.gmic)
+    if pstats.tic_e is not NULL:
+        result += (_owned_array(pstats.tic_e, 1, shape), )
+
+    # the arrays are owned by the ndarrays
     free(pstats)
 
-    return mica, tica
+    return result
 
 
 @cython.boundscheck(False)
-def cstats(X, Y, alpha=0.6, c=15, est="mic_approx"):
+def cstats(X, Y, alpha=0.6, c=15, est="mic_approx", n_jobs=1,
+           stats=("mic", "tic"), eps=0, p=-1, tau=0, edge_tau=None):
     """Compute statistics (MIC and normalized TIC) between each pair of the two
     collections of variables (convenience function).
 
@@ -301,10 +580,34 @@ def cstats(X, Y, alpha=0.6, c=15, est="mic_approx"):
         every partition. Default value is 15, meaning that when trying to
         draw x grid lines on the x-axis, the algorithm will start with at
         most 15*x clumps.
-    est : str ("mic_approx", "mic_e")
+    est : str ("mic_approx", "mic_e", "mic_e_clump")
         estimator. With est="mic_approx" the original MINE statistics will
         be computed, with est="mic_e" the equicharacteristic matrix is
-        is evaluated and MIC_e and TIC_e are returned.
+        is evaluated and MIC_e and TIC_e are returned. est="mic_e_clump"
+        computes the same MIC_e and TIC_e faster (see MINE).
+    n_jobs : int
+        number of threads among which the pairs of variables are spread. If
+        n_jobs <= 0 one thread per available core is used. Ignored if minepy
+        is compiled without OpenMP support. The GIL is released during the
+        computation, which can be interrupted (e.g. with Ctrl-C).
+    stats : sequence of str
+        the statistics to compute, among "mic", "mas", "mev", "mcn",
+        "mcn_general", "tic" (normalized) and "gmic". Only the requested
+        statistics are computed and returned, in the same order.
+    eps : float (>= 0)
+        eps of MCN.
+    p : float
+        p of GMIC.
+    tau : float (>= 0)
+        screening threshold, used if stats is ("mic",). If tau > 0 the
+        computation of each pair stops as soon as MIC >= tau is found or
+        MIC < tau is proven. The returned values are then bounds of the MIC
+        (lower bounds if >= tau, upper bounds otherwise), so that mic >= tau
+        is the screening result.
+    edge_tau : float or None
+        if not None, only the pairs with MIC >= edge_tau are returned, as an
+        edge list, without storing the matrices. stats may contain only "mic"
+        and "tic"; tau is ignored.
 
     Returns
     -------
@@ -312,14 +615,23 @@ def cstats(X, Y, alpha=0.6, c=15, est="mic_approx"):
         the MIC statistic matrix (n x p).
     tic : 2D ndarray
         the normalized TIC statistic matrix (n x p).
+
+    With a different stats, one matrix for each statistic in stats.
+
+    If edge_tau is not None, the arrays i (rows of X) and j (rows of Y) of
+    the edges, sorted by i and then by j, followed by one array for each
+    statistic in stats.
     """
 
     cdef int n, d
     cdef mine_parameter param
     cdef mine_matrix Xm, Ym
     cdef mine_cstats *cstats
+    cdef mine_edges *edges
+    cdef double edge_t = -1
+    cdef mine_options opt
+    cdef double last_check
     cdef np.ndarray[np.float_t, ndim=2] Xa, Ya
-    cdef np.ndarray[np.float_t, ndim=2] mica, tica
     cdef np.npy_intp shape[2]
 
 
@@ -337,6 +649,10 @@ def cstats(X, Y, alpha=0.6, c=15, est="mic_approx"):
     if X.shape[1] != Y.shape[1]:
         raise ValueError("X, Y: shape mismatch")
 
+    if edge_tau is not None:
+        _check_sparse_stats(stats, "edge_tau")
+        edge_t = <double> edge_tau
+
     Xm.data = <double *> Xa.data
     Xm.n = <int> Xa.shape[0]
     Xm.m = <int> Xa.shape[1]
@@ -345,18 +661,226 @@ def cstats(X, Y, alpha=0.6, c=15, est="mic_approx"):
     Ym.n = <int> Ya.shape[0]
     Ym.m = <int> Ya.shape[1]
 
-    cstats = mine_compute_cstats(&Xm, &Ym, &param)
+    mine_init_options(&opt)
+    opt.num_threads = <int> n_jobs
+    opt.stats = _stats_mask(stats)
+    opt.mcn_eps = <double> eps
+    opt.gmic_p = <double> p
+    opt.screen_tau = <double> tau
+    opt.interrupt = _check_signals
+    last_check = minepy_monotonic()
+    opt.interrupt_data = <void *> &last_check
+
+    if edge_tau is not None:
+        with nogil:
+            edges = mine_compute_cstats_edges_opt(&Xm, &Ym, &param, edge_t,
+                                                  &opt)
+
+        if edges is NULL:
+            if PyErr_Occurred() is not NULL:
+                _raise_pending()
+            raise ValueError("problem with mine_compute_cstats_edges()")
+
+        return _edges_tuple(stats, edges)
+
+    with nogil:
+        cstats = mine_compute_cstats_opt(&Xm, &Ym, &param, &opt)
+
+    if cstats is NULL:
+        if PyErr_Occurred() is not NULL:
+            _raise_pending()
+        raise ValueError("problem with mine_compute_cstats()")
 
     shape[0] = <np.npy_intp> cstats.n
     shape[1] = <np.npy_intp> cstats.m
-    mica = np.PyArray_SimpleNewFromData(2, shape, np.NPY_DOUBLE,
-                                        <void *> cstats.mic)
-    np.PyArray_UpdateFlags(mica, mica.flags.num | np.NPY_OWNDATA)
+    result = _stats_tuple(stats, 2, shape, cstats.mic, cstats.mas,
+                          cstats.mev, cstats.mcn, cstats.mcn_general,
+                          cstats.tic, cstats.gmic)
+
+    # the arrays are owned by the ndarrays
+    free(cstats)
+
+    return result
+
+
+@cython.boundscheck(False)
+def mic_scores(X, y, alpha=0.6, c=15, est="mic_approx", n_jobs=1):
+    """Compute the MIC between each variable of X and the target y
+    (convenience function).
+
+    The target is sorted and equipartitioned only once, then the variables
+    of X are scored in parallel. The result is the same as
+    cstats(X, y[np.newaxis], stats=("mic",))[0][:, 0].
+
+    Parameters
+    ----------
+    X : 2D array_like object
+        An n by m array of n variables and m samples.
+    y : 1D array_like object
+        the target variable (m samples).
+    alpha : float (0, 1.0] or >=4
+        see cstats.
+    c : float (> 0)
+        see cstats.
+    est : str ("mic_approx", "mic_e", "mic_e_clump")
+        see cstats.
+    n_jobs : int
+        number of threads among which the variables of X are spread. If
+        n_jobs <= 0 one thread per available core is used. Ignored if minepy
+        is compiled without OpenMP support. The GIL is released during the
+        computation, which can be interrupted (e.g. with Ctrl-C).
+
+    Returns
+    -------
+    mic : 1D ndarray
+        the MIC between each variable of X and y (n).
+    """
 
-    tica = np.PyArray_SimpleNewFromData(2, shape, np.NPY_DOUBLE,
-                                        <void *> cstats.tic)
-    np.PyArray_UpdateFlags(tica, tica.flags.num | np.NPY_OWNDATA)
+    cdef mine_parameter param
+    cdef mine_matrix Xm
+    cdef mine_cstats *cstats
+    cdef mine_options opt
+    cdef double last_check
+    cdef np.ndarray[np.float_t, ndim=2] Xa
+    cdef np.ndarray[np.float_t, ndim=1] ya
+    cdef np.npy_intp shape[1]
+
+
+    param.c = <double> c
+    param.alpha = <double> alpha
+    param.est = <int> EST[est]
 
+    ret = mine_check_parameter(&param)
+    if ret:
+        raise ValueError(ret)
+
+    Xa = np.ascontiguousarray(X, dtype=np.float64)
+    ya = np.ascontiguousarray(y, dtype=np.float64)
+
+    if Xa.shape[1] != ya.shape[0]:
+        raise ValueError("X, y: shape mismatch")
+
+    Xm.data = <double *> Xa.data
+    Xm.n = <int> Xa.shape[0]
+    Xm.m = <int> Xa.shape[1]
+
+    mine_init_options(&opt)
+    opt.num_threads = <int> n_jobs
+    opt.stats = STAT_MIC
+    opt.interrupt = _check_signals
+    last_check = minepy_monotonic()
+    opt.interrupt_data = <void *> &last_check
+
+    with nogil:
+        cstats = mine_compute_one_vs_many_opt(<double *> ya.data, &Xm, &param,
+                                              &opt)
+
+    if cstats is NULL:
+        if PyErr_Occurred() is not NULL:
+            _raise_pending()
+        raise ValueError("problem with mine_compute_one_vs_many()")
+
+    shape[0] = <np.npy_intp> cstats.n
+    result = _owned_array(cstats.mic, 1, shape)
+
+    # the array is owned by the ndarray
     free(cstats)
 
-    return mica, tica
+    return result
+
+
+def pair_stats(X, pairs, alpha=0.6, c=15, est="mic_approx", n_jobs=1,
+               stats=("mic", "tic"), eps=0, p=-1):
+    """Compute statistics (MIC and normalized TIC) between the listed pairs
+    of variables (convenience function).
+
+    Only the variables in pairs are sorted and equipartitioned, once each.
+
+    Parameters
+    ----------
+    X : 2D array_like object
+        An n by m array of n variables and m samples.
+    pairs : 2D array_like object
+        An npairs by 2 array of indices of variables (rows) of X. The pairs
+        may be in any order, repeated and with the first index greater than
+        the second.
+    alpha : float (0, 1.0] or >=4
+        see pstats.
+    c : float (> 0)
+        see pstats.
+    est : str ("mic_approx", "mic_e", "mic_e_clump")
+        see pstats.
+    n_jobs : int
+        see pstats.
+    stats : sequence of str
+        see pstats.
+    eps : float (>= 0)
+        eps of MCN.
+    p : float
+        p of GMIC.
+
+    Returns
+    -------
+    mic : 1D ndarray
+        the MIC of each pair (npairs).
+    tic : 1D ndarray
+        the normalized TIC of each pair (npairs).
+
+    With a different stats, one array for each statistic in stats.
+    """
+
+    cdef mine_parameter param
+    cdef mine_matrix Xm
+    cdef mine_pstats *pstats
+    cdef mine_options opt
+    cdef double last_check
+    cdef np.ndarray[np.float_t, ndim=2] Xa
+    cdef np.ndarray[int, ndim=2] pairsa
+    cdef np.npy_intp shape[1]
+
+
+    param.c = <double> c
+    param.alpha = <double> alpha
+    param.est = <int> EST[est]
+
+    ret = mine_check_parameter(&param)
+    if ret:
+        raise ValueError(ret)
+
+    Xa = np.ascontiguousarray(X, dtype=np.float64)
+    pairsa = np.ascontiguousarray(pairs, dtype=np.intc).reshape(-1, 2)
+
+    if np.any(pairsa < 0) or np.any(pairsa >= Xa.shape[0]):
+        raise ValueError("pairs: index out of range")
+
+    Xm.data = <double *> Xa.data
+    Xm.n = <int> Xa.shape[0]
+    Xm.m = <int> Xa.shape[1]
+
+    mine_init_options(&opt)
+    opt.num_threads = <int> n_jobs
+    opt.stats = _stats_mask(stats)
+    opt.mcn_eps = <double> eps
+    opt.gmic_p = <double> p
+    opt.interrupt = _check_signals
+    last_check = minepy_monotonic()
+    opt.interrupt_data = <void *> &last_check
+
+    with nogil:
+        pstats = mine_compute_pairs_opt(&Xm, <int *> pairsa.data,
+                                        <long> pairsa.shape[0], &param, &opt)
+
+    if pstats is NULL:
+        if PyErr_Occurred() is not NULL:
+            _raise_pending()
+        raise ValueError("problem with mine_compute_pairs()")
+
+    shape[0] = <np.npy_intp> pstats.n
+    result = _stats_tuple(stats, 1, shape, pstats.mic, pstats.mas,
+                          pstats.mev, pstats.mcn, pstats.mcn_general,
+                          pstats.tic, pstats.gmic)
+
+    # the arrays are owned by the ndarrays
+    free(pstats)
+
+    return result
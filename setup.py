@@ -10,16 +10,27 @@ class build_ext_custom(build_ext):
         self.include_dirs.append(numpy.get_include())
         build_ext.run(self)
 
+# OpenMP is used by libmine to spread the computation among threads. The
+# Apple compiler does not support it, in that case libmine runs serially.
 if get_platform() == "win32" or get_platform() == "win-amd64":
     libraries = []
+    openmp_compile_args = ['/openmp']
+    openmp_link_args = []
+elif get_platform().startswith("macosx"):
+    libraries = ['m']
+    openmp_compile_args = []
+    openmp_link_args = []
 else:
     libraries = ['m']
+    openmp_compile_args = ['-fopenmp']
+    openmp_link_args = ['-fopenmp']
 
 ext_modules = [
     Extension("minepy.mine",
               ["minepy/mine.c", "libmine/mine.c"],
               libraries=libraries,
-              extra_compile_args=['-Wall'])
+              extra_compile_args=['-Wall'] + openmp_compile_args,
+              extra_link_args=openmp_link_args)
     ]
 
 classifiers = [
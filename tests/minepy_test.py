@@ -1,7 +1,7 @@
 import unittest
 import numpy as np
 from numpy.testing import *
-from minepy import MINE
+from minepy import MINE, pstats, cstats, mic_scores, pair_stats
 
 
 class TestFunctions(unittest.TestCase):
@@ -71,6 +71,153 @@ class TestFunctions(unittest.TestCase):
         assert_almost_equal(self.mine.mcn(), 2., 4)
         assert_almost_equal(self.mine.mcn_general(), 2., 4)
 
+    def test_mic_e_clump(self):
+        mine_e = MINE(alpha=0.6, c=15, est="mic_e")
+        mine_clump = MINE(alpha=0.6, c=15, est="mic_e_clump")
+        for build in [self.build_const, self.build_linear, self.build_sine,
+                      self.build_exp]:
+            x, y = build(1000)
+            mine_e.compute_score(x, y)
+            mine_clump.compute_score(x, y)
+            assert_almost_equal(mine_clump.mic(), mine_e.mic())
+            assert_almost_equal(mine_clump.tic(norm=True),
+                                mine_e.tic(norm=True))
+            assert_almost_equal(mine_clump.get_score(), mine_e.get_score())
+
+    def test_all_stats(self):
+        x, y = self.build_sine(1000)
+        self.mine.compute_score(x, y)
+        stats = self.mine.all_stats(eps=0.1, p=0.5)
+        assert_equal(stats["mic"], self.mine.mic())
+        assert_equal(stats["mas"], self.mine.mas())
+        assert_equal(stats["mev"], self.mine.mev())
+        assert_equal(stats["mcn"], self.mine.mcn(0.1))
+        assert_equal(stats["mcn_general"], self.mine.mcn_general())
+        assert_equal(stats["tic"], self.mine.tic())
+        assert_equal(stats["tic_norm"], self.mine.tic(norm=True))
+        assert_equal(stats["gmic"], self.mine.gmic(0.5))
+
+    def test_get_score(self):
+        x, y = self.build_sine(1000)
+        self.mine.compute_score(x, y)
+        M = self.mine.get_score()
+        assert_equal(M.shape, (30, 30))
+        assert_almost_equal(np.nanmax(M), self.mine.mic(), 10)
+        assert_equal(np.isnan(M[-1, 1:]), True)
+        scores, m = self.mine.get_score(ragged=True)
+        assert_array_equal(m, np.sum(~np.isnan(M), axis=1))
+        assert_array_equal(scores, M[~np.isnan(M)])
+
+    def test_n_jobs(self):
+        X = np.random.RandomState(0).rand(6, 200)
+        mic, tic = pstats(X)
+        mic_p, tic_p = pstats(X, n_jobs=3)
+        assert_array_equal(mic, mic_p)
+        assert_array_equal(tic, tic_p)
+        mic_c, tic_c = cstats(X[:1], X[1:], n_jobs=3)
+        assert_array_equal(mic_c[0], mic[:5])
+        assert_array_equal(tic_c[0], tic[:5])
+
+    def test_pstats_stats(self):
+        X = np.random.RandomState(0).rand(3, 200)
+        mas, gmic = pstats(X, stats=("mas", "gmic"), p=0.5)
+        mev, = cstats(X[:1], X[1:], stats=("mev",))
+        for k, (i, j) in enumerate([(0, 1), (0, 2), (1, 2)]):
+            self.mine.compute_score(X[i], X[j])
+            assert_equal(mas[k], self.mine.mas())
+            assert_equal(gmic[k], self.mine.gmic(0.5))
+        self.mine.compute_score(X[0], X[2])
+        assert_equal(mev[0, 1], self.mine.mev())
+        assert_raises(ValueError, pstats, X, stats=("foo",))
+
+    def test_pstats_tau(self):
+        rs = np.random.RandomState(0)
+        X = rs.rand(4, 300)
+        X[1] = X[0] + 0.1 * rs.rand(300)
+        mic, = pstats(X, stats=("mic",))
+        for tau in [0.2, 0.5, 0.9]:
+            mic_s, = pstats(X, stats=("mic",), tau=tau)
+            assert_array_equal(mic_s >= tau, mic >= tau)
+
+    def test_pstats_cascade(self):
+        rs = np.random.RandomState(0)
+        X = rs.rand(6, 300)
+        X[1] = X[0]**2 + 0.05 * rs.rand(300)
+        mic, = pstats(X, stats=("mic",))
+        tic_e, = pstats(X, alpha=20, est="mic_e_clump", stats=("tic",))
+        mic_c, tic_e_c = pstats(X, stats=("mic",), cascade_alpha=20,
+                                cascade_quantile=0.9)
+        assert_array_equal(tic_e_c, tic_e)
+        sel = tic_e >= np.sort(tic_e)[int(0.9 * (len(tic_e) - 1))]
+        assert_array_equal(mic_c[sel], mic[sel])
+        assert np.all(np.isnan(mic_c[~sel]))
+        assert sel[0]
+
+    def test_pstats_top_k(self):
+        rs = np.random.RandomState(0)
+        X = rs.rand(8, 150)
+        X[1] = X[0]**2 + 0.05 * rs.rand(150)
+        mic, tic = pstats(X)
+        index, mic_k, tic_k = pstats(X, top_k=3, n_jobs=2)
+        self.assertEqual(index.shape, (8, 3))
+        iu = np.triu_indices(8, 1)
+        M, T = np.zeros((8, 8)), np.zeros((8, 8))
+        M[iu], T[iu] = mic, tic
+        M, T = M + M.T, T + T.T
+        for i in range(8):
+            order = sorted((j for j in range(8) if j != i),
+                           key=lambda j: (-M[i, j], j))[:3]
+            assert_array_equal(index[i], order)
+            assert_array_equal(mic_k[i], M[i, order])
+            assert_array_equal(tic_k[i], T[i, order])
+        self.assertEqual(pstats(X, stats=("mic",), top_k=20)[0].shape, (8, 7))
+        self.assertRaises(ValueError, pstats, X, stats=("mas",), top_k=3)
+
+    def test_edge_tau(self):
+        rs = np.random.RandomState(0)
+        X = rs.rand(8, 150)
+        X[1] = X[0]**2 + 0.05 * rs.rand(150)
+        X[5] = np.sin(4 * X[2])
+        mic, tic = pstats(X)
+        i, j, mic_e, tic_e = pstats(X, n_jobs=2, edge_tau=0.3)
+        iu = np.triu_indices(8, 1)
+        sel = mic >= 0.3
+        assert_array_equal(i, iu[0][sel])
+        assert_array_equal(j, iu[1][sel])
+        assert_array_equal(mic_e, mic[sel])
+        assert_array_equal(tic_e, tic[sel])
+        mic, = cstats(X[:4], X[4:], stats=("mic",))
+        i, j, mic_e = cstats(X[:4], X[4:], stats=("mic",), edge_tau=0.3)
+        assert_array_equal(mic_e, mic[i, j])
+        self.assertEqual(len(i), np.sum(mic >= 0.3))
+        self.assertEqual(len(pstats(X, edge_tau=2)[0]), 0)
+        self.assertRaises(ValueError, pstats, X, stats=("mas",), edge_tau=0.3)
+
+    def test_mic_scores(self):
+        rs = np.random.RandomState(0)
+        X = rs.rand(5, 200)
+        y = X[2]**2 + 0.05 * rs.rand(200)
+        for est in ["mic_approx", "mic_e"]:
+            mic, = cstats(X, y[np.newaxis], est=est, stats=("mic",))
+            assert_array_equal(mic_scores(X, y, est=est, n_jobs=2),
+                               mic[:, 0])
+        self.assertRaises(ValueError, mic_scores, X, y[:100])
+
+    def test_pair_stats(self):
+        rs = np.random.RandomState(0)
+        X = rs.rand(6, 200)
+        X[3] = X[1]**2 + 0.05 * rs.rand(200)
+        pairs = np.array([[4, 1], [1, 3], [0, 5], [3, 1], [1, 3], [2, 2]])
+        mine = MINE(alpha=0.6, c=15, est="mic_e")
+        for n_jobs in [1, 2]:
+            mic, tic = pair_stats(X, pairs, est="mic_e", n_jobs=n_jobs)
+            self.assertEqual(len(mic), len(pairs))
+            for k, (i, j) in enumerate(pairs):
+                mine.compute_score(X[i], X[j])
+                assert_equal(mic[k], mine.mic())
+                assert_equal(tic[k], mine.tic(norm=True))
+        self.assertRaises(ValueError, pair_stats, X, [[0, 6]])
+
 
 if __name__ == '__main__':
     #unittest.main()